@@ -0,0 +1,388 @@
+/* Headless rendering benchmark */
+
+#ifdef __LINUX__
+	/* framebuffer object functions are GL 3.0, ask for their prototypes */
+#define GL_GLEXT_PROTOTYPES
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "graphics.h"
+#include "bench.h"
+#include "world.h"
+#include "stats.h"
+#include "visible.h"
+#include "timer.h"
+
+extern void display(void);
+extern void reshape(int, int);
+extern void setViewPosition(float, float, float);
+extern void setViewOrientation(float, float, float);
+extern void getViewPosition(float *, float *, float *);
+extern void getViewOrientation(float *, float *, float *);
+
+extern int screenWidth, screenHeight;
+extern int displayCount;
+extern int benchWorld;
+
+/*
+ * One frame of a camera path
+ */
+struct pose {
+   float x, y, z;
+   float rx, ry;
+};
+
+// Camera path replayed by benchScene()
+static struct pose *path = NULL;
+static int pathLength = 0;
+static int pathSize = 0;
+
+// Distance ahead along a walk which the camera looks towards
+#define LOOKAHEAD 3.0
+
+// Octree culls timed from each pose and collision probes made around it
+// for -benchworld, and the distance in cubes the probes stray from the pose
+#define WORLDCULLS 4
+#define WORLDPROBES 4096
+#define PROBERANGE 3
+
+/*
+ * Heading which looks from (x0, z0) towards (x1, z1), a heading of 0
+ * looks down -z
+ */
+static float heading(float x0, float z0, float x1, float z1){
+   return atan2(x1 - x0, -(z1 - z0)) * 180.0 / M_PI;
+}
+
+void benchInitContext(int width, int height){
+#ifdef __LINUX__
+   EGLint configAttribs[] = {
+      EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+      EGL_NONE
+   };
+   EGLDisplay eglDisplay;
+   EGLConfig config = NULL;
+   EGLContext context;
+   EGLint major, minor, configs = 0;
+   GLuint framebuffer, renderbuffers[2];
+
+   // Surfaceless Mesa needs no display server, fall back to the default
+   // display for other drivers
+   eglDisplay = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+      EGL_DEFAULT_DISPLAY, NULL);
+   if(eglDisplay == EGL_NO_DISPLAY){
+      eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+   }
+   if(eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor)){
+      fprintf(stderr, "ERROR: Could not open an EGL display for -bench! Aborting!\n");
+      exit(1);
+   }
+   eglBindAPI(EGL_OPENGL_API);
+   eglChooseConfig(eglDisplay, configAttribs, &config, 1, &configs);
+   context = eglCreateContext(eglDisplay, (configs > 0) ? config : EGL_NO_CONFIG_KHR,
+      EGL_NO_CONTEXT, NULL);
+   if(context == EGL_NO_CONTEXT
+         || !eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, context)){
+      fprintf(stderr, "ERROR: Could not create an OpenGL context for -bench! Aborting!\n");
+      exit(1);
+   }
+
+   // Draw into a colour and depth framebuffer the size of the window
+   glGenFramebuffers(1, &framebuffer);
+   glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+   glGenRenderbuffers(2, renderbuffers);
+   glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+   glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+   glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+      GL_RENDERBUFFER, renderbuffers[0]);
+   glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+   glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+   glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+      GL_RENDERBUFFER, renderbuffers[1]);
+   if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE){
+      fprintf(stderr, "ERROR: Could not create the -bench framebuffer! Aborting!\n");
+      exit(1);
+   }
+#else
+   fprintf(stderr, "ERROR: -bench is only available on Linux! Aborting!\n");
+   exit(1);
+#endif
+}
+
+void benchClearPath(){
+   pathLength = 0;
+}
+
+void benchAddPose(float x, float y, float z, float rx, float ry){
+   if(pathLength == pathSize){
+      pathSize = (pathSize == 0) ? BENCHFRAMES : pathSize * 2;
+      path = realloc(path, sizeof(struct pose) * pathSize);
+      if(path == NULL){
+         fprintf(stderr, "ERROR: Could not allocate the camera path! Aborting!\n");
+         exit(1);
+      }
+   }
+   path[pathLength].x = x;
+   path[pathLength].y = y;
+   path[pathLength].z = z;
+   path[pathLength].rx = rx;
+   path[pathLength].ry = ry;
+   pathLength++;
+}
+
+int benchLoadPath(const char *scene){
+   char fileName[256];
+   struct pose p;
+   FILE *fp;
+
+   snprintf(fileName, sizeof(fileName), "%s%s.path", BENCHDIR, scene);
+   fp = fopen(fileName, "r");
+   if(fp == NULL){
+      return 0;
+   }
+   benchClearPath();
+   while(fscanf(fp, "%f %f %f %f %f", &p.x, &p.y, &p.z, &p.rx, &p.ry) == 5){
+      benchAddPose(p.x, p.y, p.z, p.rx, p.ry);
+   }
+   fclose(fp);
+   return (pathLength > 0);
+}
+
+void benchOrbitPath(float cx, float cz, float radius, float height, float pitch){
+   int i;
+
+   benchClearPath();
+   for(i = 0; i < BENCHFRAMES; i++){
+      double angle = 2.0 * M_PI * i / BENCHFRAMES;
+      float x = cx + radius * cos(angle);
+      float z = cz + radius * sin(angle);
+      benchAddPose(x, height, z, pitch, heading(x, z, cx, cz));
+   }
+}
+
+/*
+ * Point at distance along the walk through points, where length[i] is the
+ * distance to points[i]
+ */
+static void walkPoint(float points[][2], float *length, int count, float distance,
+   float *x, float *z){
+   int i = 1;
+   float t;
+
+   while(i < count - 1 && length[i] < distance){
+      i++;
+   }
+   t = (length[i] > length[i - 1])
+      ? (distance - length[i - 1]) / (length[i] - length[i - 1]) : 1.0;
+   if(t > 1.0) t = 1.0;
+   *x = points[i - 1][0] + t * (points[i][0] - points[i - 1][0]);
+   *z = points[i - 1][1] + t * (points[i][1] - points[i - 1][1]);
+}
+
+void benchWalkPath(float points[][2], int count, float eye){
+   float *length;
+   float x, z, ax, az, ry = 0.0;
+   int i;
+
+   benchClearPath();
+   if(count < 2){
+      return;
+   }
+   length = malloc(sizeof(float) * count);
+   if(length == NULL){
+      fprintf(stderr, "ERROR: Could not allocate the camera path! Aborting!\n");
+      exit(1);
+   }
+   length[0] = 0.0;
+   for(i = 1; i < count; i++){
+      length[i] = length[i - 1] + hypotf(points[i][0] - points[i - 1][0],
+         points[i][1] - points[i - 1][1]);
+   }
+   for(i = 0; i < BENCHFRAMES; i++){
+      float distance = length[count - 1] * i / (BENCHFRAMES - 1);
+      walkPoint(points, length, count, distance, &x, &z);
+      walkPoint(points, length, count, distance + LOOKAHEAD, &ax, &az);
+      // Keep the last heading once the end is in reach
+      if(ax != x || az != z){
+         ry = heading(x, z, ax, az);
+      }
+      benchAddPose(x, eye, z, 0.0, ry);
+   }
+   free(length);
+}
+
+void benchScene(const char *scene){
+   double *times, start, total;
+   // Render statistics added up over the timed frames
+   double cubes = 0, faces = 0, drawCalls = 0, materials = 0, textures = 0;
+   double nodes = 0;
+   int i, l, frames = pathLength;
+
+   if(benchWorld == 1){
+      benchWorldScene(scene);
+      return;
+   }
+   if(frames == 0){
+      fprintf(stderr, "ERROR: No camera path for scene %s!\n", scene);
+      return;
+   }
+   times = malloc(sizeof(double) * frames);
+   if(times == NULL){
+      fprintf(stderr, "ERROR: Could not allocate the frame times! Aborting!\n");
+      exit(1);
+   }
+
+   reshape(screenWidth, screenHeight);
+   for(i = -BENCHWARMUP; i < frames; i++){
+      struct pose *p = &path[(i < 0) ? 0 : i];
+      // The view position is stored negated
+      setViewPosition(-p->x, -p->y, -p->z);
+      setViewOrientation(p->rx, p->ry, 0.0);
+      start = timerMillis();
+      display();
+      // Wait for the frame to finish drawing so it is all counted
+      glFinish();
+      if(i >= 0){
+         const struct renderStats *stats = getRenderStats();
+         times[i] = timerMillis() - start;
+         cubes += stats->cubes;
+         faces += stats->faces;
+         drawCalls += stats->drawCalls;
+         materials += stats->materialChanges;
+         textures += stats->textureChanges;
+         for(l = 0; l < OCCUPANCYLEVELS; l++){
+            nodes += stats->nodesVisited[l];
+         }
+      }
+   }
+
+   total = 0.0;
+   for(i = 0; i < frames; i++){
+      total += times[i];
+   }
+   qsort(times, frames, sizeof(double), compareTimes);
+   printf("{\"scene\": \"%s\", \"frames\": %d, \"width\": %d, \"height\": %d, "
+      "\"min_ms\": %.3f, \"median_ms\": %.3f, \"p99_ms\": %.3f, "
+      "\"max_ms\": %.3f, \"mean_ms\": %.3f, "
+      "\"cubes\": %.1f, \"faces\": %.1f, \"draw_calls\": %.1f, "
+      "\"material_changes\": %.1f, \"texture_changes\": %.1f, "
+      "\"nodes_visited\": %.1f}\n",
+      scene, frames, screenWidth, screenHeight,
+      times[0], times[frames / 2], times[(frames * 99 + 99) / 100 - 1],
+      times[frames - 1], total / frames,
+      cubes / frames, faces / frames, drawCalls / frames,
+      materials / frames, textures / frames, nodes / frames);
+   fflush(stdout);
+   free(times);
+}
+
+/*
+ * Clamp a probe coordinate so it and its neighbours are inside the world
+ */
+static int probeClamp(int v, int size){
+   if(v < 1) return 1;
+   if(v > size - 2) return size - 2;
+   return v;
+}
+
+void benchWorldScene(const char *scene){
+   double start, cullTime = 0.0, probeTime = 0.0, maskTime;
+   double cubes = 0;
+   int i, n, x, y, z, frames = pathLength;
+   int tiles[3] = {0, 0, 0};
+   GLubyte id;
+   // Offsets from the pose of each probe, the same for every pose
+   static signed char offset[WORLDPROBES][3];
+   volatile int sink = 0;
+
+   if(frames == 0){
+      fprintf(stderr, "ERROR: No camera path for scene %s!\n", scene);
+      return;
+   }
+
+   srand(BENCHSEED);
+   for(n = 0; n < WORLDPROBES; n++){
+      for(i = 0; i < 3; i++){
+         offset[n][i] = rand() % (2 * PROBERANGE + 1) - PROBERANGE;
+      }
+   }
+
+   reshape(screenWidth, screenHeight);
+   for(i = 0; i < frames; i++){
+      struct pose *p = &path[i];
+      int px = (int)p->x, py = (int)p->y, pz = (int)p->z;
+
+      // Drawing the pose once sets up its frustum for the culls
+      setViewPosition(-p->x, -p->y, -p->z);
+      setViewOrientation(p->rx, p->ry, 0.0);
+      display();
+      start = timerMillis();
+      for(n = 0; n < WORLDCULLS; n++){
+         displayCount = 0;
+         tree(0.0, 0.0, 0.0, (float) WORLDX, (float) WORLDY, (float) WORLDZ);
+      }
+      cullTime += timerMillis() - start;
+      cubes += displayCount;
+
+      // The same lookups collisionResponse() makes for a move: the cube
+      // moved into, the cubes above and below it and the side steps
+      start = timerMillis();
+      for(n = 0; n < WORLDPROBES; n++){
+         int qx = probeClamp(px + offset[n][0], WORLDX);
+         int qy = probeClamp(py + offset[n][1], WORLDY);
+         int qz = probeClamp(pz + offset[n][2], WORLDZ);
+         sink += worldGet(qx, qy, qz) + worldGet(qx, qy - 1, qz)
+            + worldGet(qx, qy + 1, qz) + worldGet(qx + 1, qy, qz)
+            + worldGet(qx, qy, qz + 1);
+      }
+      probeTime += timerMillis() - start;
+   }
+
+   // Every cube in a tile which is not empty tests its six neighbours
+   start = timerMillis();
+   computeFaceMask();
+   maskTime = timerMillis() - start;
+
+   for(x = 0; x < TILEX; x++){
+      for(y = 0; y < TILEY; y++){
+         for(z = 0; z < TILEZ; z++){
+            tiles[worldTileState(x, y, z, &id)]++;
+         }
+      }
+   }
+
+   printf("{\"scene\": \"%s\", \"layout\": \"%s\", \"frames\": %d, "
+      "\"cull_ms\": %.4f, \"cubes\": %.1f, \"probe_ns\": %.2f, "
+      "\"facemask_ms\": %.3f, \"tiles_empty\": %d, \"tiles_uniform\": %d, "
+      "\"tiles_mixed\": %d, \"store_kb\": %.1f}\n",
+      scene, WORLDLAYOUT, frames,
+      cullTime / ((double)frames * WORLDCULLS), cubes / frames,
+      probeTime * 1000000.0 / ((double)frames * WORLDPROBES), maskTime,
+      tiles[TILE_EMPTY], tiles[TILE_UNIFORM], tiles[TILE_MIXED],
+      worldStoreSize() / 1024.0);
+   fflush(stdout);
+}
+
+void benchRecord(const char *file){
+   static FILE *fp = NULL;
+   float x, y, z, rx, ry, rz;
+
+   if(fp == NULL){
+      fp = fopen(file, "w");
+      if(fp == NULL){
+         fprintf(stderr, "ERROR: Could not open %s to record the camera path! Aborting!\n", file);
+         exit(1);
+      }
+   }
+   getViewPosition(&x, &y, &z);
+   getViewOrientation(&rx, &ry, &rz);
+   fprintf(fp, "%.3f %.3f %.3f %.3f %.3f\n", -x, -y, -z, rx, ry);
+   fflush(fp);
+}
@@ -0,0 +1,73 @@
+/*
+ * Headless rendering benchmark (-bench).
+ * Rendering goes to a framebuffer object in an EGL context with no surface,
+ * so no window or display server is needed (e.g. Mesa llvmpipe on a CI
+ * machine).  main() builds each benchmark scene and replays a camera path
+ * through it, the frame times of each scene are printed as one line of JSON.
+ *
+ * Camera paths are lists of poses, one for each frame.  Positions are world
+ * coordinates (not negated like the view position) and rx, ry are the
+ * rotations about x and y in degrees.  A path recorded with -record file
+ * can be copied to BENCHDIR<scene>.path to replace the generated one.
+ */
+
+	/* frames drawn before timing starts, the first builds the chunk meshes */
+#define BENCHWARMUP 10
+	/* frames in a generated camera path */
+#define BENCHFRAMES 240
+	/* floor seed used so every run draws the same world */
+#define BENCHSEED 4820
+	/* where recorded camera paths are loaded from */
+#define BENCHDIR "./bench/"
+
+/*
+ * Create the offscreen context and a width x height framebuffer to draw
+ * into, used in place of the GLUT window.  Exits if it can't be created.
+ */
+void benchInitContext(int width, int height);
+
+/*
+ * Empty the camera path, or add a pose to the end of it
+ */
+void benchClearPath();
+void benchAddPose(float x, float y, float z, float rx, float ry);
+
+/*
+ * Replace the camera path with BENCHDIR<scene>.path, returns 0 if there
+ * is no recorded path for scene
+ */
+int benchLoadPath(const char *scene);
+
+/*
+ * Replace the camera path with BENCHFRAMES poses circling (cx, cz) at
+ * height, facing the centre and looking down by pitch degrees
+ */
+void benchOrbitPath(float cx, float cz, float radius, float height, float pitch);
+
+/*
+ * Replace the camera path with BENCHFRAMES poses walking at an even speed
+ * through the count (x, z) points at eye height, looking along the way
+ */
+void benchWalkPath(float points[][2], int count, float eye);
+
+/*
+ * Draw the camera path through the current world and print the frame
+ * times for scene to stdout, along with the render statistics averaged
+ * over the frames.  Runs benchWorldScene() instead for -benchworld.
+ */
+void benchScene(const char *scene);
+
+/*
+ * Time the world accesses along the camera path for -benchworld and print
+ * them for scene to stdout as one line of JSON: the octree cull from each
+ * pose, collision style probes around each pose, a full face mask
+ * rebuild and how many tiles are empty, uniform and mixed.  Build with
+ * -DWORLDLINEAR to compare against the plain layout.
+ */
+void benchWorldScene(const char *scene);
+
+/*
+ * Append the current view to file as a camera path pose, display() calls
+ * this once a frame for -record
+ */
+void benchRecord(const char *file);
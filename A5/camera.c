@@ -0,0 +1,179 @@
+/* CPU copies of the viewpoint matrices */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "camera.h"
+
+// Current matrices, column major
+static float projection[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+static float view[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+static float clip[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+
+static unsigned int changes = 0;
+
+/*
+ * Work out the clip matrix again after either matrix has been replaced.
+ * Nothing is counted as changed when the new matrices are the same.
+ */
+static void updateClip(const double p[16], const double v[16]){
+   float newProjection[16], newView[16];
+   int i, j, k;
+
+   for(i = 0; i < 16; i++){
+      newProjection[i] = (float)p[i];
+      newView[i] = (float)v[i];
+   }
+   if(memcmp(newProjection, projection, sizeof(projection)) == 0
+         && memcmp(newView, view, sizeof(view)) == 0){
+      return;
+   }
+   memcpy(projection, newProjection, sizeof(projection));
+   memcpy(view, newView, sizeof(view));
+   for(i = 0; i < 4; i++){
+      for(j = 0; j < 4; j++){
+         clip[i * 4 + j] = 0.0;
+         for(k = 0; k < 4; k++){
+            clip[i * 4 + j] += view[i * 4 + k] * projection[k * 4 + j];
+         }
+      }
+   }
+   changes++;
+}
+
+/*
+ * Copy of a current matrix in double precision
+ */
+static void current(const float m[16], double out[16]){
+   int i;
+
+   for(i = 0; i < 16; i++){
+      out[i] = m[i];
+   }
+}
+
+/*
+ * a = a * b, column major
+ */
+static void multiply(double a[16], const double b[16]){
+   double r[16];
+   int i, j, k;
+
+   for(i = 0; i < 4; i++){
+      for(j = 0; j < 4; j++){
+         r[i * 4 + j] = 0.0;
+         for(k = 0; k < 4; k++){
+            r[i * 4 + j] += a[k * 4 + j] * b[i * 4 + k];
+         }
+      }
+   }
+   memcpy(a, r, sizeof(r));
+}
+
+/*
+ * m = m * rotation of angle degrees about a unit axis, same as glRotatef()
+ */
+static void rotate(double m[16], double angle, double x, double y, double z){
+   double r[16];
+   double c = cos(angle * M_PI / 180.0);
+   double s = sin(angle * M_PI / 180.0);
+
+   memset(r, 0, sizeof(r));
+   r[0] = x * x * (1 - c) + c;
+   r[1] = y * x * (1 - c) + z * s;
+   r[2] = x * z * (1 - c) - y * s;
+   r[4] = x * y * (1 - c) - z * s;
+   r[5] = y * y * (1 - c) + c;
+   r[6] = y * z * (1 - c) + x * s;
+   r[8] = x * z * (1 - c) + y * s;
+   r[9] = y * z * (1 - c) - x * s;
+   r[10] = z * z * (1 - c) + c;
+   r[15] = 1.0;
+   multiply(m, r);
+}
+
+void cameraPerspective(float fovy, float aspect, float znear, float zfar){
+   double p[16], v[16];
+   double f = 1.0 / tan(fovy * M_PI / 360.0);
+
+   memset(p, 0, sizeof(p));
+   p[0] = f / aspect;
+   p[5] = f;
+   p[10] = ((double)zfar + znear) / ((double)znear - zfar);
+   p[11] = -1.0;
+   p[14] = 2.0 * zfar * znear / ((double)znear - zfar);
+   current(view, v);
+   updateClip(p, v);
+}
+
+void cameraView(float rx, float ry, float rz, float tx, float ty, float tz){
+   double p[16], v[16];
+   double t[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+
+   memcpy(v, t, sizeof(v));
+   rotate(v, rx, 1.0, 0.0, 0.0);
+   rotate(v, ry, 0.0, 1.0, 0.0);
+   rotate(v, rz, 0.0, 0.0, 1.0);
+   t[12] = tx;
+   t[13] = ty;
+   t[14] = tz;
+   multiply(v, t);
+   current(projection, p);
+   updateClip(p, v);
+}
+
+void cameraLookAt(float ex, float ey, float ez, float cx, float cy, float cz,
+   float ux, float uy, float uz){
+   double p[16], v[16];
+   double f[3], s[3], u[3], len;
+   int i;
+
+   f[0] = cx - ex;
+   f[1] = cy - ey;
+   f[2] = cz - ez;
+   len = sqrt(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+   for(i = 0; i < 3; i++){
+      f[i] /= len;
+   }
+   // s = f x up, u = s x f
+   s[0] = f[1] * uz - f[2] * uy;
+   s[1] = f[2] * ux - f[0] * uz;
+   s[2] = f[0] * uy - f[1] * ux;
+   len = sqrt(s[0] * s[0] + s[1] * s[1] + s[2] * s[2]);
+   for(i = 0; i < 3; i++){
+      s[i] /= len;
+   }
+   u[0] = s[1] * f[2] - s[2] * f[1];
+   u[1] = s[2] * f[0] - s[0] * f[2];
+   u[2] = s[0] * f[1] - s[1] * f[0];
+
+   memset(v, 0, sizeof(v));
+   for(i = 0; i < 3; i++){
+      v[i * 4 + 0] = s[i];
+      v[i * 4 + 1] = u[i];
+      v[i * 4 + 2] = -f[i];
+   }
+   v[12] = -(s[0] * ex + s[1] * ey + s[2] * ez);
+   v[13] = -(u[0] * ex + u[1] * ey + u[2] * ez);
+   v[14] = f[0] * ex + f[1] * ey + f[2] * ez;
+   v[15] = 1.0;
+   current(projection, p);
+   updateClip(p, v);
+}
+
+const float *cameraProjectionMatrix(){
+   return projection;
+}
+
+const float *cameraViewMatrix(){
+   return view;
+}
+
+const float *cameraClipMatrix(){
+   return clip;
+}
+
+unsigned int cameraChanges(){
+   return changes;
+}
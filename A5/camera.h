@@ -0,0 +1,43 @@
+/*
+ * Viewpoint matrices kept on the CPU.
+ * reshape() sets the projection and display() sets the view from the same
+ * state they used to hand to OpenGL, and both are loaded into OpenGL from
+ * here.  Culling reads the matrices from here instead of reading them back
+ * with glGetFloatv(), which stalls the pipeline.
+ * Matrices are 4x4 and column major, the same as glLoadMatrixf().
+ */
+
+/*
+ * Set the projection, same as gluPerspective()
+ */
+void cameraPerspective(float fovy, float aspect, float znear, float zfar);
+
+/*
+ * Set the view to glRotatef() about x, y and then z by rx, ry and rz
+ * degrees followed by glTranslatef(tx, ty, tz), the order display() uses
+ */
+void cameraView(float rx, float ry, float rz, float tx, float ty, float tz);
+
+/*
+ * Set the view, same as gluLookAt()
+ */
+void cameraLookAt(float ex, float ey, float ez, float cx, float cy, float cz,
+   float ux, float uy, float uz);
+
+/*
+ * The current projection and view (modelview) matrices
+ */
+const float *cameraProjectionMatrix();
+const float *cameraViewMatrix();
+
+/*
+ * The view combined with the projection, takes world coordinates to clip
+ * space.  Element [i * 4 + j] is row j of column i.
+ */
+const float *cameraClipMatrix();
+
+/*
+ * Count of changes to the matrices, anything worked out from them (such as
+ * the frustum planes) only needs to be redone when it changes
+ */
+unsigned int cameraChanges();
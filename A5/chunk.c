@@ -0,0 +1,532 @@
+
+/* Chunked, greedy meshed vertex arrays for the world array */
+/* Greedy meshing approach from: */
+/* https://0fps.net/2012/06/30/meshing-in-a-minecraft-game/ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "graphics.h"
+#include "chunk.h"
+#include "shader.h"
+#include "world.h"
+#include "stats.h"
+
+
+	/* material and texture controls from graphics.c */
+extern void setObjectColour(int);
+extern void setObjectTexture(int);
+extern void unsetObjectTexture(int);
+extern void setObjectAtlas();
+extern int getAtlasGroup(int);
+extern float tOffset[NUMBERCOLOURS][2];
+extern int textureAssigned[NUMBERCOLOURS];
+
+	/* texture atlas from graphics.c, used when textureAtlas == 1 */
+extern int textureAtlas;
+extern float atlasRegion[NUMBERTEXTURES][4];
+	/* colours are looked up by the shader when shaderRendering == 1 */
+extern int shaderRendering;
+
+	/* grid of chunks covering the world array, and a second grid */
+	/* shiftChunks() builds the moved grid in */
+static struct chunk *chunks = NULL;
+static struct chunk *spareChunks = NULL;
+
+	/* next batch to draw of each chunk in drawChunkList(), CHUNKCOUNT */
+static int *cursor = NULL;
+
+	/* per colour vertex lists used while meshing a single chunk */
+static struct chunkBatch scratch[NUMBERCOLOURS];
+
+/*
+ * Append one vertex to a batch, growing it as needed
+ */
+static void pushVertex(struct chunkBatch *b, float p[3], float n[3], float u, float v, int colour){
+   if(b->count == b->size){
+      b->size = (b->size == 0) ? 256 : b->size * 2;
+      b->verts = realloc(b->verts, sizeof(struct chunkVertex) * b->size);
+      if(b->verts == NULL){
+         fprintf(stderr, "ERROR: Could not grow chunk vertex array! Aborting!\n");
+         exit(1);
+      }
+   }
+   struct chunkVertex *vert = &(b->verts[b->count++]);
+   vert->u = u;
+   vert->v = v;
+   vert->nx = n[0];
+   vert->ny = n[1];
+   vert->nz = n[2];
+   vert->x = p[0];
+   vert->y = p[1];
+   vert->z = p[2];
+   vert->colour = colour;
+}
+
+/*
+ * Texture coordinates for a corner of a face pointing along +/- axis.
+ * Matches the orientation drawCube() uses for each side so a merged face
+ * looks the same as the individual cubes it replaces (textures repeat).
+ */
+static void faceUV(int axis, int sign, float p[3], float *u, float *v){
+   switch(axis){
+      case 0: // +x / -x
+         *u = (sign > 0) ? -p[2] : p[2];
+         *v = -p[1];
+         break;
+      case 1: // top / bottom
+         *u = p[0];
+         *v = (sign > 0) ? p[2] : -p[2];
+         break;
+      default: // +z / -z
+         *u = (sign > 0) ? p[0] : -p[0];
+         *v = -p[1];
+         break;
+   }
+}
+
+/*
+ * Emit a w x h rectangle of 'colour' faces in slice 'depth' along 'axis' as
+ * a quad into the vertex list for 'batch'.
+ * (i, j) is the rectangle corner along the two other axes which are always
+ * taken in cyclic order so the winding is counter clockwise facing out.
+ * If atlas is set the texture coordinates are mapped into the colour's area
+ * of the texture atlas, the quad must not cross a texture repeat.
+ */
+static void emitQuad(int batch, int colour, int axis, int sign, int depth, float i, float j, float w, float h, int atlas){
+   int uAxis = (axis + 1) % 3;
+   int vAxis = (axis + 2) % 3;
+   float corner[4][2] = {{i, j}, {i + w, j}, {i + w, j + h}, {i, j + h}};
+   float n[3] = {0.0, 0.0, 0.0};
+   float p[3], baseU = 0.0, baseV = 0.0;
+   float *region = NULL;
+   int c;
+
+   n[axis] = sign;
+   p[axis] = depth + ((sign > 0) ? 1 : 0);
+   if(atlas){
+      // Find which repeat of the texture this quad falls in from its centre
+      region = atlasRegion[textureAssigned[colour]];
+      p[uAxis] = i + w / 2.0;
+      p[vAxis] = j + h / 2.0;
+      faceUV(axis, sign, p, &baseU, &baseV);
+      baseU = floorf(baseU);
+      baseV = floorf(baseV);
+   }
+   for(c = 0; c < 4; c++){
+      // Reverse the winding for faces pointing down an axis
+      int k = (sign > 0) ? c : 3 - c;
+      float u, v;
+      p[uAxis] = corner[k][0];
+      p[vAxis] = corner[k][1];
+      faceUV(axis, sign, p, &u, &v);
+      if(region != NULL){
+         u = region[0] + (u - baseU) * region[2];
+         v = region[1] + (v - baseV) * region[3];
+      }
+      pushVertex(&scratch[batch], p, n, u, v, colour);
+   }
+}
+
+/*
+ * Colours with a texture offset (animated textures such as lava) can't be
+ * taken from the atlas, which doesn't wrap.  They keep their own texture
+ * and batch, and drawChunkList() shifts them with the texture matrix.
+ */
+static int atlasColour(int colour){
+   return textureAtlas && textureAssigned[colour] != -1
+      && tOffset[colour][0] == 0.0 && tOffset[colour][1] == 0.0;
+}
+
+/*
+ * Build the vertex arrays for a single chunk
+ */
+static void meshChunk(struct chunk *ch){
+   int mask[CHUNKSIZE][CHUNKSIZE];
+   int size[3], origin[3];
+   int axis, sign, depth, i, j, w, h, c;
+
+   origin[0] = ch->ox;
+   origin[1] = ch->oy;
+   origin[2] = ch->oz;
+   // Chunks along the far edges of the world may be cut short
+   size[0] = (WORLDX - ch->ox < CHUNKSIZE) ? WORLDX - ch->ox : CHUNKSIZE;
+   size[1] = (WORLDY - ch->oy < CHUNKSIZE) ? WORLDY - ch->oy : CHUNKSIZE;
+   size[2] = (WORLDZ - ch->oz < CHUNKSIZE) ? WORLDZ - ch->oz : CHUNKSIZE;
+
+   for(c = 0; c < NUMBERCOLOURS; c++){
+      scratch[c].count = 0;
+   }
+   memset(ch->colours, 0, sizeof(ch->colours));
+
+   // Sweep each of the six face directions one slice at a time, an empty
+   // chunk (as sliding the outdoor world leaves many) has nothing to find
+   for(axis = 0; axis < 3 && ch->solidCount > 0; axis++){
+      int uAxis = (axis + 1) % 3;
+      int vAxis = (axis + 2) % 3;
+      for(sign = -1; sign <= 1; sign += 2){
+         // FACE_* bits are ordered +x, -x, +y, -y, +z, -z
+         int bit = 1 << (axis * 2 + ((sign > 0) ? 0 : 1));
+         for(depth = 0; depth < size[axis]; depth++){
+            // Find the exposed faces in this slice
+            for(i = 0; i < size[uAxis]; i++){
+               for(j = 0; j < size[vAxis]; j++){
+                  int p[3];
+                  p[axis] = origin[axis] + depth;
+                  p[uAxis] = origin[uAxis] + i;
+                  p[vAxis] = origin[vAxis] + j;
+                  if(faceMaskGet(p[0], p[1], p[2]) & bit){
+                     mask[i][j] = worldGet(p[0], p[1], p[2]);
+                  } else {
+                     mask[i][j] = 0;
+                  }
+               }
+            }
+            // Merge runs of matching faces into rectangles
+            for(j = 0; j < size[vAxis]; j++){
+               for(i = 0; i < size[uAxis]; ){
+                  c = mask[i][j];
+                  if(c == 0){
+                     i++;
+                     continue;
+                  }
+                  ch->colours[c] = 1;
+                  // Atlas textures can't repeat across a merged face
+                  // without the shader
+                  if(!shaderRendering && atlasColour(c)){
+                     emitQuad(getAtlasGroup(c), c, axis, sign, depth, i, j, 1, 1, 1);
+                     i++;
+                     continue;
+                  }
+                  // Grow along u as far as the colour matches
+                  for(w = 1; i + w < size[uAxis] && mask[i + w][j] == c; w++);
+                  // Grow along v while the whole row matches
+                  for(h = 1; j + h < size[vAxis]; h++){
+                     int k;
+                     for(k = 0; k < w && mask[i + k][j + h] == c; k++);
+                     if(k < w) break;
+                  }
+                  emitQuad(shaderRendering ? 0 : c, c, axis, sign, depth, i, j, w, h, 0);
+                  // Clear the merged faces
+                  int a, b;
+                  for(a = 0; a < w; a++){
+                     for(b = 0; b < h; b++){
+                        mask[i + a][j + b] = 0;
+                     }
+                  }
+                  i += w;
+               }
+            }
+         }
+      }
+   }
+
+   // Copy the finished lists into the chunk, reusing its old arrays
+   for(i = 0; i < ch->batchCount; i++){
+      free(ch->batches[i].verts);
+   }
+   ch->batchCount = 0;
+   for(c = 0; c < NUMBERCOLOURS; c++){
+      if(scratch[c].count > 0){
+         ch->batchCount++;
+      }
+   }
+   ch->batches = realloc(ch->batches, sizeof(struct chunkBatch) * (ch->batchCount + 1));
+   i = 0;
+   for(c = 0; c < NUMBERCOLOURS; c++){
+      if(scratch[c].count > 0){
+         ch->batches[i].colour = c;
+         ch->batches[i].count = scratch[c].count;
+         ch->batches[i].size = scratch[c].count;
+         ch->batches[i].verts = malloc(sizeof(struct chunkVertex) * scratch[c].count);
+         memcpy(ch->batches[i].verts, scratch[c].verts, sizeof(struct chunkVertex) * scratch[c].count);
+         i++;
+      }
+   }
+   ch->dirty = 0;
+}
+
+/*
+ * Copy world contents into the chunk's shadow copy.
+ * Returns 1 if anything was different.
+ */
+static int syncShadow(struct chunk *ch){
+   int x, y, z, changed = 0;
+   int sx = (WORLDX - ch->ox < CHUNKSIZE) ? WORLDX - ch->ox : CHUNKSIZE;
+   int sy = (WORLDY - ch->oy < CHUNKSIZE) ? WORLDY - ch->oy : CHUNKSIZE;
+   int sz = (WORLDZ - ch->oz < CHUNKSIZE) ? WORLDZ - ch->oz : CHUNKSIZE;
+
+   // The world is read one tile-long run along z at a time
+   for(x = 0; x < sx; x++){
+      for(y = 0; y < sy; y++){
+         for(z = 0; z < sz; z += TILESIZE){
+            int length = (sz - z < TILESIZE) ? sz - z : TILESIZE;
+            GLubyte run[TILESIZE];
+            worldRun(ch->ox + x, ch->oy + y, ch->oz + z, length, run);
+            if(memcmp(&ch->shadow[x][y][z], run, length) != 0){
+               memcpy(&ch->shadow[x][y][z], run, length);
+               changed = 1;
+            }
+         }
+      }
+   }
+   if(changed){
+      ch->solidCount = 0;
+      for(x = 0; x < sx; x++){
+         for(y = 0; y < sy; y++){
+            for(z = 0; z < sz; z++){
+               if(ch->shadow[x][y][z] != 0) ch->solidCount++;
+            }
+         }
+      }
+   }
+   return changed;
+}
+
+void initChunks(){
+   int x, y, z;
+
+   chunks = calloc(CHUNKCOUNT, sizeof(struct chunk));
+   spareChunks = calloc(CHUNKCOUNT, sizeof(struct chunk));
+   cursor = calloc(CHUNKCOUNT, sizeof(int));
+   if(chunks == NULL || spareChunks == NULL || cursor == NULL){
+      fprintf(stderr, "ERROR: Could not allocate world chunks! Aborting!\n");
+      exit(1);
+   }
+   for(x = 0; x < CHUNKX; x++){
+      for(y = 0; y < CHUNKY; y++){
+         for(z = 0; z < CHUNKZ; z++){
+            struct chunk *ch = &(chunks[CHUNKINDEX(x, y, z)]);
+            ch->ox = x * CHUNKSIZE;
+            ch->oy = y * CHUNKSIZE;
+            ch->oz = z * CHUNKSIZE;
+            ch->dirty = 1;
+         }
+      }
+   }
+}
+
+void shiftChunks(int dx, int dz){
+   struct chunk *swap;
+   int x, y, z, dropped = 0, reused = 0;
+   // Chunks which fall off one side are reused for the ones coming in
+   int *drop = malloc(sizeof(int) * CHUNKCOUNT);
+
+   if(drop == NULL){
+      fprintf(stderr, "ERROR: Could not allocate the chunk shift! Aborting!\n");
+      exit(1);
+   }
+   for(x = 0; x < CHUNKX; x++){
+      for(y = 0; y < CHUNKY; y++){
+         for(z = 0; z < CHUNKZ; z++){
+            if(x - dx < 0 || x - dx >= CHUNKX || z - dz < 0 || z - dz >= CHUNKZ){
+               drop[dropped++] = CHUNKINDEX(x, y, z);
+            }
+         }
+      }
+   }
+
+   for(x = 0; x < CHUNKX; x++){
+      for(y = 0; y < CHUNKY; y++){
+         for(z = 0; z < CHUNKZ; z++){
+            int sx = x + dx, sz = z + dz;
+            struct chunk *ch = &spareChunks[CHUNKINDEX(x, y, z)];
+            if(sx >= 0 && sx < CHUNKX && sz >= 0 && sz < CHUNKZ){
+               *ch = chunks[CHUNKINDEX(sx, y, sz)];
+               // The mesh moves with the chunk, unless the chunk grew or
+               // shrank at the far side of the world or its faces along
+               // the edge of the world changed
+               if((dx != 0 && (x == 0 || x == CHUNKX - 1 || sx == 0 || sx == CHUNKX - 1))
+                     || (dz != 0 && (z == 0 || z == CHUNKZ - 1 || sz == 0 || sz == CHUNKZ - 1))){
+                  ch->dirty = 1;
+               }
+            } else {
+               *ch = chunks[drop[reused++]];
+               ch->dirty = 1;
+            }
+            // A reused chunk may have come from another height as well
+            ch->ox = x * CHUNKSIZE;
+            ch->oy = y * CHUNKSIZE;
+            ch->oz = z * CHUNKSIZE;
+         }
+      }
+   }
+   free(drop);
+   swap = chunks;
+   chunks = spareChunks;
+   spareChunks = swap;
+}
+
+/*
+ * Atlas meshes have the texture area and shared material of each colour
+ * built into them, flag the chunks using any colour where these have
+ * changed since the last frame, or which has moved in or out of the atlas.
+ * Changing the offset of a colour already drawn with one needs no remesh.
+ */
+static void checkAtlasColours(){
+   static int lastTexture[NUMBERCOLOURS], lastGroup[NUMBERCOLOURS];
+   static int lastAtlas[NUMBERCOLOURS];
+   static int first = 1;
+   int c, i;
+
+   for(c = 1; c < NUMBERCOLOURS; c++){
+      int group = getAtlasGroup(c);
+      int atlas = atlasColour(c);
+      if(!first && lastTexture[c] == textureAssigned[c] && lastGroup[c] == group
+            && lastAtlas[c] == atlas){
+         continue;
+      }
+      lastTexture[c] = textureAssigned[c];
+      lastGroup[c] = group;
+      lastAtlas[c] = atlas;
+      for(i = 0; i < CHUNKCOUNT; i++){
+         if(chunks[i].colours[c]){
+            chunks[i].dirty = 1;
+         }
+      }
+   }
+   first = 0;
+}
+
+void updateChunks(){
+   // Edit generation the chunks were last brought up to
+   static unsigned int seen = 0;
+   int x, y, z;
+
+   if(textureAtlas && !shaderRendering){
+      checkAtlasColours();
+   }
+
+   // Find every chunk whose contents changed, only chunks edited since the
+   // last update need to be compared.  A change can expose or hide faces in
+   // the neighbouring chunks so flag them as well.
+   for(x = 0; x < CHUNKX; x++){
+      for(y = 0; y < CHUNKY; y++){
+         for(z = 0; z < CHUNKZ; z++){
+            if(chunkGeneration(x, y, z) <= seen){
+               continue;
+            }
+            if(syncShadow(&(chunks[CHUNKINDEX(x, y, z)]))){
+               chunks[CHUNKINDEX(x, y, z)].dirty = 1;
+               if(x > 0) chunks[CHUNKINDEX(x - 1, y, z)].dirty = 1;
+               if(x < CHUNKX - 1) chunks[CHUNKINDEX(x + 1, y, z)].dirty = 1;
+               if(y > 0) chunks[CHUNKINDEX(x, y - 1, z)].dirty = 1;
+               if(y < CHUNKY - 1) chunks[CHUNKINDEX(x, y + 1, z)].dirty = 1;
+               if(z > 0) chunks[CHUNKINDEX(x, y, z - 1)].dirty = 1;
+               if(z < CHUNKZ - 1) chunks[CHUNKINDEX(x, y, z + 1)].dirty = 1;
+            }
+         }
+      }
+   }
+   seen = worldGeneration();
+
+   // Remesh
+   for(x = 0; x < CHUNKCOUNT; x++){
+      if(chunks[x].dirty){
+         meshChunk(&(chunks[x]));
+      }
+   }
+}
+
+int chunkEmpty(int x, int y, int z){
+   return (chunks[CHUNKINDEX(x, y, z)].batchCount == 0);
+}
+
+/*
+ * Draw chunks with the shader, each chunk has one batch holding all colours
+ */
+static void drawShaderChunkList(int list[][3], int count){
+   int i;
+
+   beginShader();
+   for(i = 0; i < count; i++){
+      struct chunk *ch = &(chunks[CHUNKINDEX(list[i][0], list[i][1], list[i][2])]);
+      struct chunkBatch *b;
+      if(ch->batchCount == 0){
+         continue;
+      }
+      b = &(ch->batches[0]);
+      glPushMatrix();
+      glTranslatef(ch->ox, ch->oy, ch->oz);
+      glInterleavedArrays(GL_T2F_N3F_V3F, sizeof(struct chunkVertex), b->verts);
+      shaderColourPointer(sizeof(struct chunkVertex), &(b->verts[0].colour));
+      glDrawArrays(GL_QUADS, 0, b->count);
+      glPopMatrix();
+      frameStats.chunks++;
+      frameStats.faces += b->count / 4;
+      frameStats.drawCalls++;
+   }
+   endShader();
+   glDisableClientState(GL_VERTEX_ARRAY);
+   glDisableClientState(GL_NORMAL_ARRAY);
+   glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+}
+
+void drawChunkList(int list[][3], int count){
+   int used[NUMBERCOLOURS];
+   int c, i;
+
+   if(shaderRendering){
+      drawShaderChunkList(list, count);
+      return;
+   }
+   frameStats.chunks += count;
+
+   // Each chunk's batches are stored in colour order, so walking the colours
+   // in order only ever looks at the next batch of each chunk
+   memset(used, 0, sizeof(used));
+   for(i = 0; i < count; i++){
+      struct chunk *ch = &(chunks[CHUNKINDEX(list[i][0], list[i][1], list[i][2])]);
+      int b;
+      cursor[i] = 0;
+      for(b = 0; b < ch->batchCount; b++){
+         used[ch->batches[b].colour] = 1;
+      }
+   }
+
+   for(c = 0; c < NUMBERCOLOURS; c++){
+      if(!used[c]){
+         continue;
+      }
+      // One material and texture setup for every chunk using this colour
+      setObjectColour(c);
+      if(atlasColour(c)){
+         setObjectAtlas();
+      } else {
+         setObjectTexture(c);
+      }
+      // Shift the texture for animated/offset textures
+      if(tOffset[c][0] != 0.0 || tOffset[c][1] != 0.0){
+         glMatrixMode(GL_TEXTURE);
+         glLoadIdentity();
+         glTranslatef(tOffset[c][0], tOffset[c][1], 0.0);
+         glMatrixMode(GL_MODELVIEW);
+      }
+      for(i = 0; i < count; i++){
+         struct chunk *ch = &(chunks[CHUNKINDEX(list[i][0], list[i][1], list[i][2])]);
+         struct chunkBatch *b;
+         if(cursor[i] >= ch->batchCount || ch->batches[cursor[i]].colour != c){
+            continue;
+         }
+         b = &(ch->batches[cursor[i]++]);
+         glPushMatrix();
+         glTranslatef(ch->ox, ch->oy, ch->oz);
+         glInterleavedArrays(GL_T2F_N3F_V3F, sizeof(struct chunkVertex), b->verts);
+         glDrawArrays(GL_QUADS, 0, b->count);
+         glPopMatrix();
+         frameStats.faces += b->count / 4;
+         frameStats.drawCalls++;
+      }
+      if(tOffset[c][0] != 0.0 || tOffset[c][1] != 0.0){
+         glMatrixMode(GL_TEXTURE);
+         glLoadIdentity();
+         glMatrixMode(GL_MODELVIEW);
+      }
+      unsetObjectTexture(c);
+   }
+   glDisableClientState(GL_VERTEX_ARRAY);
+   glDisableClientState(GL_NORMAL_ARRAY);
+   glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+}
@@ -0,0 +1,79 @@
+/*
+ * Chunked world meshes.
+ * The world array is split into CHUNKSIZE^3 chunks (see graphics.h) and each
+ * chunk is greedy meshed into one vertex array per colour id.  A chunk is
+ * only remeshed when one of its cubes changes.
+ */
+
+/*
+ * Vertex layout starts with GL_T2F_N3F_V3F so a batch can be handed straight
+ * to glInterleavedArrays().  Positions are local to the chunk origin.
+ * The colour id is only read by the shader path.
+ */
+struct chunkVertex {
+   GLfloat u, v;
+   GLfloat nx, ny, nz;
+   GLfloat x, y, z;
+   GLfloat colour;
+};
+
+/*
+ * All of the faces in a chunk which share a colour id (GL_QUADS)
+ */
+struct chunkBatch {
+   // Colour id from the world array
+   int colour;
+   // Number of vertices stored and space allocated
+   int count;
+   int size;
+   struct chunkVertex *verts;
+};
+
+struct chunk {
+   // World position of the lower corner of the chunk
+   int ox, oy, oz;
+   // Set when the chunk must be remeshed before it is drawn
+   int dirty;
+   // Number of non-empty cubes in the chunk
+   int solidCount;
+   // One batch for each colour id used by an exposed face, when drawing
+   // from the texture atlas textured colours may share a batch and with
+   // shaders every face is in batch 0
+   int batchCount;
+   struct chunkBatch *batches;
+   // Flags for each colour id which has an exposed face in the chunk
+   GLubyte colours[NUMBERCOLOURS];
+   // Copy of the world contents at the last mesh, used to spot changes
+   GLubyte shadow[CHUNKSIZE][CHUNKSIZE][CHUNKSIZE];
+};
+
+/*
+ * Allocate the chunk grid and flag every chunk for meshing
+ */
+void initChunks();
+
+/*
+ * Compare the chunks edited since the last update (see chunkGeneration())
+ * against their copies and remesh any chunk whose cubes (or whose
+ * neighbours' border cubes) have changed
+ */
+void updateChunks();
+
+/*
+ * Move the chunks along with worldShift(), which moved the world by
+ * (dx * CHUNKSIZE, dz * CHUNKSIZE).  Meshes are kept for the chunks whose
+ * cubes only moved, the rest are flagged to be remeshed.
+ */
+void shiftChunks(int dx, int dz);
+
+/*
+ * Returns true if the chunk at chunk coordinates (x,y,z) has nothing to draw
+ */
+int chunkEmpty(int x, int y, int z);
+
+/*
+ * Draw the meshes for the count chunks (chunk coordinates) in list.
+ * Batches are drawn grouped by colour id so each material and texture is
+ * only set up once.
+ */
+void drawChunkList(int list[][3], int count);
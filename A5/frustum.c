@@ -0,0 +1,344 @@
+/* Batched frustum tests for axis aligned boxes */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#include "graphics.h"
+#include "frustum.h"
+#include "visible.h"
+#include "camera.h"
+#include "timer.h"
+
+// Planes from ExtractFrustum() in visible.c, normal (a,b,c) and distance d
+extern float frustum[6][4];
+
+int frustumTestBoxesMaskedScalar(int count, const float *cx, const float *cy,
+   const float *cz, const float *ex, const float *ey, const float *ez,
+   int planes, unsigned char *result, unsigned char *masks){
+   int i, p, visible = 0;
+   float plane[6][4], absNormal[6][3];
+
+   // Local copy so the planes are not reloaded after every store to result
+   for(p = 0; p < 6; p++){
+      plane[p][0] = frustum[p][0];
+      plane[p][1] = frustum[p][1];
+      plane[p][2] = frustum[p][2];
+      plane[p][3] = frustum[p][3];
+      absNormal[p][0] = fabsf(frustum[p][0]);
+      absNormal[p][1] = fabsf(frustum[p][1]);
+      absNormal[p][2] = fabsf(frustum[p][2]);
+   }
+
+   for(i = 0; i < count; i++){
+      unsigned char r = 2, crossing = 0;
+      for(p = 0; p < 6; p++){
+         float dist, radius;
+         if(!(planes & (1 << p))){
+            continue;
+         }
+         dist = plane[p][0] * cx[i] + plane[p][1] * cy[i]
+            + plane[p][2] * cz[i] + plane[p][3];
+         radius = absNormal[p][0] * ex[i] + absNormal[p][1] * ey[i]
+            + absNormal[p][2] * ez[i];
+         // Furthest corner is still behind the plane
+         if(dist + radius <= 0){
+            r = 0;
+            break;
+         }
+         // Nearest corner is behind the plane, box crosses it
+         if(dist - radius <= 0){
+            r = 1;
+            crossing |= 1 << p;
+         }
+      }
+      result[i] = r;
+      if(masks != NULL){
+         masks[i] = crossing;
+      }
+      if(r != 0){
+         visible++;
+      }
+   }
+   return visible;
+}
+
+int frustumTestBoxesScalar(int count, const float *cx, const float *cy,
+   const float *cz, const float *ex, const float *ey, const float *ez,
+   unsigned char *result){
+   return frustumTestBoxesMaskedScalar(count, cx, cy, cz, ex, ey, ez,
+      FRUSTUM_ALLPLANES, result, NULL);
+}
+
+#if defined(__AVX__)
+
+const char *frustumSimdName(){
+   return "AVX";
+}
+
+int frustumTestBoxesMasked(int count, const float *cx, const float *cy,
+   const float *cz, const float *ex, const float *ey, const float *ez,
+   int planes, unsigned char *result, unsigned char *masks){
+   int i, p, lane, used = 0, visible = 0;
+   int index[6];
+   __m256 zero = _mm256_setzero_ps();
+   __m256 a[6], b[6], c[6], d[6], absA[6], absB[6], absC[6];
+
+   // Broadcast each plane still being tested once for the whole batch
+   for(p = 0; p < 6; p++){
+      if(!(planes & (1 << p))){
+         continue;
+      }
+      index[used] = p;
+      a[used] = _mm256_set1_ps(frustum[p][0]);
+      b[used] = _mm256_set1_ps(frustum[p][1]);
+      c[used] = _mm256_set1_ps(frustum[p][2]);
+      d[used] = _mm256_set1_ps(frustum[p][3]);
+      absA[used] = _mm256_set1_ps(fabsf(frustum[p][0]));
+      absB[used] = _mm256_set1_ps(fabsf(frustum[p][1]));
+      absC[used] = _mm256_set1_ps(fabsf(frustum[p][2]));
+      used++;
+   }
+
+   // Eight boxes at a time, the leftovers use the scalar test
+   for(i = 0; i + 8 <= count; i += 8){
+      __m256 x = _mm256_loadu_ps(cx + i);
+      __m256 y = _mm256_loadu_ps(cy + i);
+      __m256 z = _mm256_loadu_ps(cz + i);
+      __m256 sx = _mm256_loadu_ps(ex + i);
+      __m256 sy = _mm256_loadu_ps(ey + i);
+      __m256 sz = _mm256_loadu_ps(ez + i);
+      int outMask = 0, crossMask = 0;
+      unsigned char crossing[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+      for(p = 0; p < used; p++){
+         __m256 dist = _mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(a[p], x), _mm256_mul_ps(b[p], y)),
+            _mm256_add_ps(_mm256_mul_ps(c[p], z), d[p]));
+         __m256 radius = _mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(absA[p], sx), _mm256_mul_ps(absB[p], sy)),
+            _mm256_mul_ps(absC[p], sz));
+         int cross = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_sub_ps(dist, radius), zero, _CMP_LE_OQ));
+         outMask |= _mm256_movemask_ps(_mm256_cmp_ps(_mm256_add_ps(dist, radius), zero, _CMP_LE_OQ));
+         crossMask |= cross;
+         if(masks != NULL && cross != 0){
+            for(lane = 0; lane < 8; lane++){
+               crossing[lane] |= ((cross >> lane) & 1) << index[p];
+            }
+         }
+      }
+      // 0 when outside, otherwise 1 when crossing a plane and 2 when inside
+      for(lane = 0; lane < 8; lane++){
+         result[i + lane] = ((~outMask >> lane) & 1) * (2 - ((crossMask >> lane) & 1));
+      }
+      if(masks != NULL){
+         memcpy(masks + i, crossing, 8);
+      }
+      visible += __builtin_popcount(~outMask & 0xff);
+   }
+   if(i < count){
+      visible += frustumTestBoxesMaskedScalar(count - i, cx + i, cy + i, cz + i,
+         ex + i, ey + i, ez + i, planes, result + i, (masks != NULL) ? masks + i : NULL);
+   }
+   return visible;
+}
+
+#elif defined(__SSE__)
+
+const char *frustumSimdName(){
+   return "SSE";
+}
+
+int frustumTestBoxesMasked(int count, const float *cx, const float *cy,
+   const float *cz, const float *ex, const float *ey, const float *ez,
+   int planes, unsigned char *result, unsigned char *masks){
+   int i, p, lane, used = 0, visible = 0;
+   int index[6];
+   __m128 zero = _mm_setzero_ps();
+   __m128 a[6], b[6], c[6], d[6], absA[6], absB[6], absC[6];
+
+   // Broadcast each plane still being tested once for the whole batch
+   for(p = 0; p < 6; p++){
+      if(!(planes & (1 << p))){
+         continue;
+      }
+      index[used] = p;
+      a[used] = _mm_set1_ps(frustum[p][0]);
+      b[used] = _mm_set1_ps(frustum[p][1]);
+      c[used] = _mm_set1_ps(frustum[p][2]);
+      d[used] = _mm_set1_ps(frustum[p][3]);
+      absA[used] = _mm_set1_ps(fabsf(frustum[p][0]));
+      absB[used] = _mm_set1_ps(fabsf(frustum[p][1]));
+      absC[used] = _mm_set1_ps(fabsf(frustum[p][2]));
+      used++;
+   }
+
+   // Four boxes at a time, the leftovers use the scalar test
+   for(i = 0; i + 4 <= count; i += 4){
+      __m128 x = _mm_loadu_ps(cx + i);
+      __m128 y = _mm_loadu_ps(cy + i);
+      __m128 z = _mm_loadu_ps(cz + i);
+      __m128 sx = _mm_loadu_ps(ex + i);
+      __m128 sy = _mm_loadu_ps(ey + i);
+      __m128 sz = _mm_loadu_ps(ez + i);
+      int outMask = 0, crossMask = 0;
+      unsigned char crossing[4] = {0, 0, 0, 0};
+      for(p = 0; p < used; p++){
+         __m128 dist = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(a[p], x), _mm_mul_ps(b[p], y)),
+            _mm_add_ps(_mm_mul_ps(c[p], z), d[p]));
+         __m128 radius = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(absA[p], sx), _mm_mul_ps(absB[p], sy)),
+            _mm_mul_ps(absC[p], sz));
+         int cross = _mm_movemask_ps(_mm_cmple_ps(_mm_sub_ps(dist, radius), zero));
+         outMask |= _mm_movemask_ps(_mm_cmple_ps(_mm_add_ps(dist, radius), zero));
+         crossMask |= cross;
+         if(masks != NULL && cross != 0){
+            for(lane = 0; lane < 4; lane++){
+               crossing[lane] |= ((cross >> lane) & 1) << index[p];
+            }
+         }
+      }
+      // 0 when outside, otherwise 1 when crossing a plane and 2 when inside
+      for(lane = 0; lane < 4; lane++){
+         result[i + lane] = ((~outMask >> lane) & 1) * (2 - ((crossMask >> lane) & 1));
+      }
+      if(masks != NULL){
+         memcpy(masks + i, crossing, 4);
+      }
+      visible += __builtin_popcount(~outMask & 0xf);
+   }
+   if(i < count){
+      visible += frustumTestBoxesMaskedScalar(count - i, cx + i, cy + i, cz + i,
+         ex + i, ey + i, ez + i, planes, result + i, (masks != NULL) ? masks + i : NULL);
+   }
+   return visible;
+}
+
+#else
+
+const char *frustumSimdName(){
+   return "scalar";
+}
+
+int frustumTestBoxesMasked(int count, const float *cx, const float *cy,
+   const float *cz, const float *ex, const float *ey, const float *ez,
+   int planes, unsigned char *result, unsigned char *masks){
+   return frustumTestBoxesMaskedScalar(count, cx, cy, cz, ex, ey, ez,
+      planes, result, masks);
+}
+
+#endif
+
+int frustumTestBoxes(int count, const float *cx, const float *cy,
+   const float *cz, const float *ex, const float *ey, const float *ez,
+   unsigned char *result){
+   return frustumTestBoxesMasked(count, cx, cy, cz, ex, ey, ez,
+      FRUSTUM_ALLPLANES, result, NULL);
+}
+
+int frustumTestCubes(int count, const float *cx, const float *cy,
+   const float *cz, float size, unsigned char *result){
+   static float *extent = NULL;
+   static int extentSize = 0;
+   int i;
+
+   // Shared array of half sizes, only rebuilt when it grows or the size changes
+   if(count > extentSize || (extentSize > 0 && extent[0] != size)){
+      if(count > extentSize){
+         extent = realloc(extent, sizeof(float) * count);
+         if(extent == NULL){
+            printf("ERROR: Could not allocate frustum extents.\n");
+            exit(1);
+         }
+         extentSize = count;
+      }
+      for(i = 0; i < extentSize; i++){
+         extent[i] = size;
+      }
+   }
+   return frustumTestBoxes(count, cx, cy, cz, extent, extent, extent, result);
+}
+
+void frustumBenchmark(){
+   int boxes = 1 << 16, rounds = 50;
+   int i, r, hits = 0, mismatch = 0;
+   float *cx, *cy, *cz, *ex;
+   unsigned char *result, *scalar;
+   double start, cubeTime, cube2Time, scalarTime, batchTime;
+   volatile int sink = 0;
+
+   cx = malloc(sizeof(float) * boxes);
+   cy = malloc(sizeof(float) * boxes);
+   cz = malloc(sizeof(float) * boxes);
+   ex = malloc(sizeof(float) * boxes);
+   result = malloc(boxes);
+   scalar = malloc(boxes);
+   if(cx == NULL || cy == NULL || cz == NULL || ex == NULL || result == NULL || scalar == NULL){
+      printf("ERROR: Could not allocate benchmark boxes.\n");
+      exit(1);
+   }
+
+   // Look across the middle of the world from one corner
+   cameraPerspective(45.0, 4.0 / 3.0, 0.1, 300.0);
+   cameraLookAt(5.0, 35.0, 5.0, WORLDX / 2.0, WORLDY / 4.0, WORLDZ / 2.0, 0.0, 1.0, 0.0);
+   ExtractFrustum();
+
+   // Random cubes and octree sized boxes spread over the world
+   srand(4820);
+   for(i = 0; i < boxes; i++){
+      cx[i] = (float)rand() / RAND_MAX * WORLDX;
+      cy[i] = (float)rand() / RAND_MAX * WORLDY;
+      cz[i] = (float)rand() / RAND_MAX * WORLDZ;
+      ex[i] = (i % 8 == 0) ? (float)(rand() % 16 + 1) : 0.5;
+   }
+
+   start = timerMillis();
+   for(r = 0; r < rounds; r++)
+      for(i = 0; i < boxes; i++)
+         sink += CubeInFrustum(cx[i], cy[i], cz[i], ex[i]);
+   cubeTime = timerMillis() - start;
+
+   start = timerMillis();
+   for(r = 0; r < rounds; r++)
+      for(i = 0; i < boxes; i++)
+         sink += CubeInFrustum2(cx[i], cy[i], cz[i], ex[i]);
+   cube2Time = timerMillis() - start;
+
+   start = timerMillis();
+   for(r = 0; r < rounds; r++)
+      sink += frustumTestBoxesScalar(boxes, cx, cy, cz, ex, ex, ex, scalar);
+   scalarTime = timerMillis() - start;
+
+   start = timerMillis();
+   for(r = 0; r < rounds; r++)
+      hits = frustumTestBoxes(boxes, cx, cy, cz, ex, ex, ex, result);
+   batchTime = timerMillis() - start;
+
+   // The batch results should agree with the corner tests
+   for(i = 0; i < boxes; i++){
+      if(result[i] != CubeInFrustum(cx[i], cy[i], cz[i], ex[i]) || result[i] != scalar[i]){
+         mismatch++;
+      }
+   }
+
+   printf("Frustum benchmark: %d boxes x %d rounds, %d visible\n", boxes, rounds, hits);
+   printf("   CubeInFrustum    %8.2f ns/box\n", cubeTime * 1e6 / ((double)boxes * rounds));
+   printf("   CubeInFrustum2   %8.2f ns/box\n", cube2Time * 1e6 / ((double)boxes * rounds));
+   printf("   batch scalar     %8.2f ns/box\n", scalarTime * 1e6 / ((double)boxes * rounds));
+   printf("   batch %-10s %8.2f ns/box\n", frustumSimdName(), batchTime * 1e6 / ((double)boxes * rounds));
+   printf("   %d boxes differ from CubeInFrustum\n", mismatch);
+
+   free(cx);
+   free(cy);
+   free(cz);
+   free(ex);
+   free(result);
+   free(scalar);
+}
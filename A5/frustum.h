@@ -0,0 +1,63 @@
+/*
+ * Batched view frustum tests.
+ * Boxes are given as centres and half extents in separate arrays (one array
+ * per component) and are tested against the planes found by ExtractFrustum()
+ * using the centre/extent form: a box is outside a plane when its centre is
+ * further behind the plane than the projection of its extents onto the plane
+ * normal.  The batch is tested with AVX, SSE or plain C depending on what the
+ * compiler targets (AVX needs -mavx).
+ */
+
+	/* number of boxes gathered up before a batch is tested */
+#define FRUSTUMBATCH 256
+	/* plane mask with all six frustum planes, bit p is frustum[p] */
+#define FRUSTUM_ALLPLANES 0x3f
+
+/*
+ * Test count boxes centred on (cx,cy,cz) with half extents (ex,ey,ez).
+ * result[i] is set like CubeInFrustum(): 0 outside, 1 crossing the frustum
+ * and 2 completely inside.  Returns how many boxes are not outside.
+ * Call ExtractFrustum() first.
+ */
+int frustumTestBoxes(int count, const float *cx, const float *cy,
+   const float *cz, const float *ex, const float *ey, const float *ez,
+   unsigned char *result);
+
+/*
+ * Same as frustumTestBoxes() but only the planes whose bits are set in
+ * planes are tested, the others are assumed to have the boxes inside them.
+ * When masks is not NULL masks[i] gets the planes box i crosses, a child
+ * of the box only needs those planes tested (0 means completely inside).
+ */
+int frustumTestBoxesMasked(int count, const float *cx, const float *cy,
+   const float *cz, const float *ex, const float *ey, const float *ez,
+   int planes, unsigned char *result, unsigned char *masks);
+
+/*
+ * Same as frustumTestBoxes() for cubes which all have half size size
+ */
+int frustumTestCubes(int count, const float *cx, const float *cy,
+   const float *cz, float size, unsigned char *result);
+
+/*
+ * Plain C versions of frustumTestBoxesMasked() and frustumTestBoxes(), used
+ * as the fallback and by the benchmark
+ */
+int frustumTestBoxesMaskedScalar(int count, const float *cx, const float *cy,
+   const float *cz, const float *ex, const float *ey, const float *ez,
+   int planes, unsigned char *result, unsigned char *masks);
+
+int frustumTestBoxesScalar(int count, const float *cx, const float *cy,
+   const float *cz, const float *ex, const float *ey, const float *ez,
+   unsigned char *result);
+
+/*
+ * Name of the instruction set used by frustumTestBoxes()
+ */
+const char *frustumSimdName();
+
+/*
+ * Time CubeInFrustum() against the batched tests on random boxes and print
+ * the results (-benchfrustum).  Needs a GL context for ExtractFrustum().
+ */
+void frustumBenchmark();
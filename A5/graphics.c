@@ -11,8 +11,14 @@
 
 #include "graphics.h"
 #include "mesh.h"
-
-GLubyte  world[WORLDX][WORLDY][WORLDZ];
+#include "chunk.h"
+#include "shader.h"
+#include "camera.h"
+#include "bench.h"
+#include "profile.h"
+#include "trace.h"
+#include "world.h"
+#include "stats.h"
 
 #define MOB_COUNT 10
 #define PLAYER_COUNT 10
@@ -21,6 +27,7 @@ GLubyte  world[WORLDX][WORLDY][WORLDZ];
 extern void update();
 extern void collisionResponse();
 extern void buildDisplayList();
+extern void initCulling();
 extern void mouse(int, int, int, int);
 extern void draw2D();
 
@@ -72,6 +79,15 @@ int textureAssigned[NUMBERCOLOURS];
 	/* [0] is u offset, [1] is v offset */
 float tOffset[NUMBERCOLOURS][2];
 
+	/* all cube textures packed into one texture, used by the chunk */
+	/* meshes when textureAtlas == 1 */
+GLuint   atlasID;
+	/* area of the atlas holding each texture, [0],[1] are the u,v */
+	/* of the lower corner, [2],[3] are the width and height */
+float atlasRegion[NUMBERTEXTURES][4];
+	/* texels copied around each texture so filtering wraps correctly */
+#define ATLASPAD 2
+
 	/* texture information for meshes, mirrors previous texture variables */
 GLuint   meshtextureID[NUMBERMESH];
 int meshtextureCount = 0;
@@ -108,10 +124,41 @@ int testWorld = 0;		// sample world for timing tests
 int fps = 0;			// turn on frame per second output
 int netClient = 0;		// network client flag, is client when = 1
 int netServer = 0;		// network server flag, is server when = 1
-
-	/* list of cubes to display */
-int displayList[MAX_DISPLAY_LIST][3];
-int displayCount = 0;		// count of cubes in displayList[][]
+int chunkRendering = 1;		// draw chunk meshes when 1, single cubes when 0
+int textureAtlas = 0;		// draw chunk textures from one atlas when 1
+int shaderRendering = 0;	// draw chunks with GLSL shaders when 1
+int occlusionCulling = 0;	// cull boxes hidden behind nearby solid columns when 1
+int benchFrustum = 0;		// time the frustum tests and exit when 1
+int cullThreads = 0;		// threads used for culling, 0 for one per processor
+int benchMode = 0;		// draw a camera path offscreen, print timings and exit when 1
+int benchWorld = 0;		// time world accesses instead of frames in benchMode when 1
+char *recordFile = NULL;	// file the viewpoint is written to each frame for -record
+int showProfile = 0;		// draw the frame profiler overlay when 1, toggled with 'p'
+char *profileFile = NULL;	// CSV the frame profile is written to for -profile
+char *traceFile = NULL;		// Chrome trace of frame and simulation spans for -trace
+int showStats = 0;		// draw the render statistics overlay when 1, toggled with 'i'
+
+	/* list of cubes to display, packed with PACKCUBE() */
+	/* it grows as cubes are added, displaySize is the space allocated */
+unsigned int *displayList = NULL;
+int displayCount = 0;		// count of cubes in displayList[]
+static int displaySize = 0;
+	/* list the same size as displayList, sortDisplayList() sorts */
+	/* into it and then swaps the two */
+static unsigned int *sortedList = NULL;
+
+	/* list of chunks to display, used instead of the cube */
+	/* displayList[] when chunkRendering == 1, room for CHUNKCOUNT */
+int (*chunkDisplayList)[3] = NULL;
+int chunkDisplayCount = 0;	// count of chunks in chunkDisplayList[][]
+
+	/* material/texture state last sent to OpenGL while drawing the world */
+	/* the cache is only trusted between beginWorldState() and */
+	/* endWorldState() as other drawing code sets materials directly */
+static int stateCacheActive = 0;
+static int cachedColour = -1;	// colour id of current material, -1 unknown
+static int cachedTexture = -1;	// texture number bound, -1 unknown
+static int cachedTextureOn = 0;	// 1 when GL_TEXTURE_2D is enabled
 
 	/* list of mobs - number of mobs, xyz values and rotation about y */
 float mobPosition[MOB_COUNT][4];
@@ -152,6 +199,8 @@ void  draw2Dline(int, int, int, int, int);
 void  draw2Dbox(int, int, int, int);
 void  draw2Dtriangle(int, int, int, int, int, int);
 void  set2Dcolour(float []);
+void  begin2Dpanel(int, int, int, int);
+void  end2Dpanel();
 
 	/* texture functions attach textures to cubes */
 int setAssignedTexture(int, int);
@@ -380,18 +429,73 @@ void getViewOrientation(float *xaxis, float *yaxis, float *zaxis) {
    *zaxis = mvz;
 }
 
-        /* add the cube at world[x][y][z] to the display list and */
+	/* make room in the display list for at least count cubes */
+static void growDisplayList(int count) {
+   if (count <= displaySize)
+      return;
+   while (displaySize < count)
+      displaySize = (displaySize == 0) ? 4096 : displaySize * 2;
+   displayList = realloc(displayList, sizeof(unsigned int) * displaySize);
+   sortedList = realloc(sortedList, sizeof(unsigned int) * displaySize);
+   if ((displayList == NULL) || (sortedList == NULL)) {
+      printf("Could not grow the display list.\n");
+      exit(1);
+   }
+}
+
+        /* add the cube at (x,y,z) to the display list and */
         /* increment displayCount */
 void addDisplayList(int x, int y, int z) {
-   displayList[displayCount][0] = x;
-   displayList[displayCount][1] = y;
-   displayList[displayCount][2] = z;
-   displayCount++;
-   if (displayCount > MAX_DISPLAY_LIST) {
-      printf("You have put more items in the display list then there are\n");
-      printf("cubes in the world. Set displayCount = 0 at some point.\n");
-      exit(1);
+   if (displayCount == displaySize)
+      growDisplayList(displayCount + 1);
+   displayList[displayCount++] = PACKCUBE(x, y, z);
+}
+
+        /* add count cubes already packed with PACKCUBE() to the end */
+        /* of the display list */
+void appendDisplayList(const unsigned int *cubes, int count) {
+   growDisplayList(displayCount + count);
+   memcpy(&displayList[displayCount], cubes, sizeof(unsigned int) * count);
+   displayCount += count;
+}
+
+        /* reorder the displayList so cubes with the same colour id */
+        /* are next to each other, lets drawCube() share materials */
+void sortDisplayList() {
+unsigned int *swap;
+int start[NUMBERCOLOURS];
+int i, c, total;
+unsigned int cube;
+
+	/* counting sort on the colour id of each cube */
+   memset(start, 0, sizeof(start));
+   for(i=0; i<displayCount; i++) {
+      cube = displayList[i];
+      start[worldGet(CUBEX(cube), CUBEY(cube), CUBEZ(cube))]++;
+   }
+   total = 0;
+   for(c=0; c<NUMBERCOLOURS; c++) {
+      int n = start[c];
+      start[c] = total;
+      total += n;
    }
+   for(i=0; i<displayCount; i++) {
+      cube = displayList[i];
+      c = worldGet(CUBEX(cube), CUBEY(cube), CUBEZ(cube));
+      sortedList[start[c]++] = cube;
+   }
+   swap = displayList;
+   displayList = sortedList;
+   sortedList = swap;
+}
+
+        /* add the chunk at chunk coordinates x,y,z to the chunk display */
+        /* list and increment chunkDisplayCount */
+void addChunkDisplayList(int x, int y, int z) {
+   chunkDisplayList[chunkDisplayCount][0] = x;
+   chunkDisplayList[chunkDisplayCount][1] = y;
+   chunkDisplayList[chunkDisplayCount][2] = z;
+   chunkDisplayCount++;
 }
 
 
@@ -439,8 +543,28 @@ void init (void)
 
 }
 
-	/* pass in the number representing the colour, sets OpenGL materials */
-void setObjectColour(int colourID) {
+	/* start drawing world cubes, material and texture changes which */
+	/* would not change the OpenGL state are skipped until endWorldState() */
+void beginWorldState() {
+   stateCacheActive = 1;
+   cachedColour = -1;
+   cachedTexture = -1;
+   cachedTextureOn = 0;
+}
+
+	/* stop caching state, turns off any texture left on from the world */
+void endWorldState() {
+   if (cachedTextureOn == 1)
+      glDisable(GL_TEXTURE_2D);
+   stateCacheActive = 0;
+   cachedColour = -1;
+   cachedTexture = -1;
+   cachedTextureOn = 0;
+}
+
+	/* look up the ambient and diffuse material for a colour number */
+	/* returns 1 if the colour has not been allocated, 0 otherwise */
+int getObjectColour(int colourID, GLfloat amb[4], GLfloat dif[4]) {
 	/* predefined colours */
 GLfloat blue[]  = {0.0, 0.0, 1.0, 1.0};
 GLfloat red[]   = {1.0, 0.0, 0.0, 1.0};
@@ -456,48 +580,70 @@ GLfloat dgreen[] = {0.0, 0.5, 0.0, 1.0};
 GLfloat dyellow[]   = {0.5, 0.5, 0.0, 1.0};
 GLfloat dpurple[]   = {0.5, 0.0, 0.5, 1.0};
 GLfloat dorange[]   = {0.5, 0.32, 0.0, 1.0};
+GLfloat *a, *d;
 
 	/* system defined colours are numbers 1 to 8 */
 	/* user defined colours are 9-99 */
    if (colourID == 1) {
-      glMaterialfv(GL_FRONT, GL_AMBIENT, dgreen);
-      glMaterialfv(GL_FRONT, GL_DIFFUSE, green);
+      a = dgreen;
+      d = green;
    }
    else if (colourID == 2) { 
-      glMaterialfv(GL_FRONT, GL_AMBIENT, dblue);
-      glMaterialfv(GL_FRONT, GL_DIFFUSE, blue);
+      a = dblue;
+      d = blue;
    }
    else if (colourID == 3) {
-      glMaterialfv(GL_FRONT, GL_AMBIENT, dred);
-      glMaterialfv(GL_FRONT, GL_DIFFUSE, red);
+      a = dred;
+      d = red;
    }
    else if (colourID == 4) {
-      glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, black);
+      a = black;
+      d = black;
    }
    else if (colourID == 5) {
-      glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, white);
+      a = white;
+      d = white;
    }
    else if (colourID == 6) {
-      glMaterialfv(GL_FRONT, GL_AMBIENT, dpurple);
-      glMaterialfv(GL_FRONT, GL_DIFFUSE, purple);
+      a = dpurple;
+      d = purple;
    }
    else if (colourID == 7) { 
-      glMaterialfv(GL_FRONT, GL_AMBIENT, dorange);
-      glMaterialfv(GL_FRONT, GL_DIFFUSE, orange);
+      a = dorange;
+      d = orange;
    }
    else if (colourID == 8) { 
-      glMaterialfv(GL_FRONT, GL_AMBIENT, dyellow);
-      glMaterialfv(GL_FRONT, GL_DIFFUSE, yellow);
+      a = dyellow;
+      d = yellow;
    } else {
-		/* user define colour */
-      if (uColourUsed[ colourID ] != 1) {
-         printf("ERROR, attempt to access colour which is not allocated.\n");
-      }
 		/* user defined colours, look up the RGBA colour values */
 		/* for the world value in the user defined colour array */
-      glMaterialfv(GL_FRONT, GL_AMBIENT, uAmbColour[ colourID ]);
-      glMaterialfv(GL_FRONT, GL_DIFFUSE, uDifColour[ colourID ]);
+      memcpy(amb, uAmbColour[ colourID ], sizeof(GLfloat) * 4);
+      memcpy(dif, uDifColour[ colourID ], sizeof(GLfloat) * 4);
+      return((uColourUsed[ colourID ] != 1) ? 1 : 0);
+   }
+   memcpy(amb, a, sizeof(GLfloat) * 4);
+   memcpy(dif, d, sizeof(GLfloat) * 4);
+   return(0);
+}
+
+	/* pass in the number representing the colour, sets OpenGL materials */
+void setObjectColour(int colourID) {
+GLfloat amb[4], dif[4];
+
+	/* material is already set */
+   if (stateCacheActive == 1) {
+      if (colourID == cachedColour)
+         return;
+      cachedColour = colourID;
+   }
+
+   if (getObjectColour(colourID, amb, dif) == 1) {
+      printf("ERROR, attempt to access colour which is not allocated.\n");
    }
+   glMaterialfv(GL_FRONT, GL_AMBIENT, amb);
+   glMaterialfv(GL_FRONT, GL_DIFFUSE, dif);
+   frameStats.materialChanges++;
 }
 
 	/* activate texture using textureid stored in colourID */
@@ -505,33 +651,99 @@ void setObjectTexture(int colourID) {
 GLfloat white[] = {1.0, 1.0, 1.0, 1.0};
 	/* if a texture is bound to that colour then enable texturing */
    if (textureAssigned[colourID] != -1) {
-      glEnable(GL_TEXTURE_2D);
-      glBindTexture(GL_TEXTURE_2D, textureID[textureAssigned[colourID]]);
+      if ((stateCacheActive == 0) || (cachedTextureOn == 0)) {
+         glEnable(GL_TEXTURE_2D);
+         cachedTextureOn = 1;
+      }
+      if ((stateCacheActive == 0) ||
+          (cachedTexture != textureAssigned[colourID])) {
+         glBindTexture(GL_TEXTURE_2D, textureID[textureAssigned[colourID]]);
+         cachedTexture = textureAssigned[colourID];
+         frameStats.textureChanges++;
+      }
 	/* if textured, then use white as base colour */
 //      glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, white);
+   } else if ((stateCacheActive == 1) && (cachedTextureOn == 1)) {
+	/* texturing was left on by the last world cube */
+      glDisable(GL_TEXTURE_2D);
+      cachedTextureOn = 0;
    }
 
 }
 
 
 void unsetObjectTexture(int colourID) {
+	/* while drawing the world leave texturing on, the next */
+	/* setObjectTexture() turns it off if it isn't needed */
+   if (stateCacheActive == 1)
+      return;
 	/* if a texture is bound to that colour then disable texturing */
    if (textureAssigned[colourID] != -1) {
       glDisable(GL_TEXTURE_2D);
    }
 }
 
-	/* draw cube in world[i][j][k] */
+	/* enable texturing using the texture atlas, used for chunk meshes */
+	/* whose texture coordinates have been mapped into the atlas */
+void setObjectAtlas() {
+   if ((stateCacheActive == 0) || (cachedTextureOn == 0)) {
+      glEnable(GL_TEXTURE_2D);
+      cachedTextureOn = 1;
+   }
+	/* NUMBERTEXTURES is never a texture number, use it for the atlas */
+   if ((stateCacheActive == 0) || (cachedTexture != NUMBERTEXTURES)) {
+      glBindTexture(GL_TEXTURE_2D, atlasID);
+      cachedTexture = NUMBERTEXTURES;
+      frameStats.textureChanges++;
+   }
+}
+
+	/* colours drawn from the atlas which have the same material can */
+	/* share a mesh, returns the lowest colour id with the same texturing */
+	/* and material as colourID (or colourID itself), colours with a */
+	/* texture offset are not drawn from the atlas and never share */
+int getAtlasGroup(int colourID) {
+int i;
+   if ((textureAssigned[colourID] == -1) || (colourID < 9)
+       || (tOffset[colourID][0] != 0.0) || (tOffset[colourID][1] != 0.0))
+      return(colourID);
+   for(i=9; i<colourID; i++) {
+      if ((textureAssigned[i] != -1) && (uColourUsed[i] == 1)
+          && (tOffset[i][0] == 0.0) && (tOffset[i][1] == 0.0)
+          && (memcmp(uAmbColour[i], uAmbColour[colourID], sizeof(GLfloat) * 4) == 0)
+          && (memcmp(uDifColour[i], uDifColour[colourID], sizeof(GLfloat) * 4) == 0))
+         return(i);
+   }
+   return(colourID);
+}
+
+	/* draw cube at (i,j,k) */
 void drawCube(int i, int j, int k) {
 	// colour/texture number for this cube
 int colourId;
+	// exposed sides of this cube
+GLubyte faces;
+int sides;
 	// texture coordinates
 float umin, umax, vmin, vmax;
 
 GLfloat white[] = {1.0, 1.0, 1.0, 1.0};
 //   glMaterialfv(GL_FRONT, GL_SPECULAR, white);
 
-   colourId = world[i][j][k];
+   faces = faceMaskGet(i, j, k);
+	/* nothing to draw if the cube is surrounded */
+   if (faces == 0) return;
+
+	/* each exposed side is drawn with two glBegin() calls */
+   frameStats.cubes++;
+   for(sides=0; sides<6; sides++) {
+      if (faces & (1 << sides)) {
+         frameStats.faces++;
+         frameStats.drawCalls += 2;
+      }
+   }
+
+   colourId = worldGet(i, j, k);
 		/* select colour based on value in the world array */
    setObjectColour(colourId);
 		/* set texture */
@@ -550,134 +762,201 @@ GLfloat white[] = {1.0, 1.0, 1.0, 1.0};
    vmin = fmodf(0.0 + tOffset[colourId][1], 1.0);
    vmax = fmodf(1.0 + tOffset[colourId][1], 1.0);
 
-		// draw cube
+		// draw cube, only the sides which are not covered
 		// side 1
-   glNormal3f(1.0, 0.0, 0.0);
-   glBegin(GL_TRIANGLES);
-      glTexCoord2f(0.0 + umin, 0.0 + vmax);
-      glVertex3f(0.5, 0.5, 0.5);
-      glTexCoord2f(1.0 + umax, 1.0 + vmin);
-      glVertex3f(0.5, -0.5, -0.5);
-      glTexCoord2f(0.0 + umin, 1.0 + vmin);
-      glVertex3f(0.5, -0.5, 0.5);
-   glEnd();
-
-   glBegin(GL_TRIANGLES);
-      glTexCoord2f(0.0 + umin, 0.0 + vmax);
-      glVertex3f(0.5, 0.5, 0.5);
-      glTexCoord2f(1.0 + umax, 0.0 + vmax);
-      glVertex3f(0.5, 0.5, -0.5);
-      glTexCoord2f(1.0 + umax, 1.0 + vmin);
-      glVertex3f(0.5, -0.5, -0.5);
-   glEnd();
+   if (faces & FACE_XPOS) {
+      glNormal3f(1.0, 0.0, 0.0);
+      glBegin(GL_TRIANGLES);
+         glTexCoord2f(0.0 + umin, 0.0 + vmax);
+         glVertex3f(0.5, 0.5, 0.5);
+         glTexCoord2f(1.0 + umax, 1.0 + vmin);
+         glVertex3f(0.5, -0.5, -0.5);
+         glTexCoord2f(0.0 + umin, 1.0 + vmin);
+         glVertex3f(0.5, -0.5, 0.5);
+      glEnd();
+
+      glBegin(GL_TRIANGLES);
+         glTexCoord2f(0.0 + umin, 0.0 + vmax);
+         glVertex3f(0.5, 0.5, 0.5);
+         glTexCoord2f(1.0 + umax, 0.0 + vmax);
+         glVertex3f(0.5, 0.5, -0.5);
+         glTexCoord2f(1.0 + umax, 1.0 + vmin);
+         glVertex3f(0.5, -0.5, -0.5);
+      glEnd();
+   }
 
 		// side 2
-   glNormal3f(0.0, 0.0, 1.0);
-   glBegin(GL_TRIANGLES);
-      glTexCoord2f(0.0 + umin, 0.0 + vmax);
-      glVertex3f(-0.5, 0.5, 0.5);
-      glTexCoord2f(1.0 + umax, 1.0 + vmin);
-      glVertex3f(0.5, -0.5, 0.5);
-      glTexCoord2f(0.0 + umin, 1.0 + vmin);
-      glVertex3f(-0.5, -0.5, 0.5);
-   glEnd();
-
-   glBegin(GL_TRIANGLES);
-      glTexCoord2f(0.0 + umin, 0.0 + vmax);
-      glVertex3f(-0.5, 0.5, 0.5);
-      glTexCoord2f(1.0 + umax, 0.0 + vmax);
-      glVertex3f(0.5, 0.5, 0.5);
-      glTexCoord2f(1.0 + umax, 1.0 + vmin);
-      glVertex3f(0.5, -0.5, 0.5);
-   glEnd();
+   if (faces & FACE_ZPOS) {
+      glNormal3f(0.0, 0.0, 1.0);
+      glBegin(GL_TRIANGLES);
+         glTexCoord2f(0.0 + umin, 0.0 + vmax);
+         glVertex3f(-0.5, 0.5, 0.5);
+         glTexCoord2f(1.0 + umax, 1.0 + vmin);
+         glVertex3f(0.5, -0.5, 0.5);
+         glTexCoord2f(0.0 + umin, 1.0 + vmin);
+         glVertex3f(-0.5, -0.5, 0.5);
+      glEnd();
+
+      glBegin(GL_TRIANGLES);
+         glTexCoord2f(0.0 + umin, 0.0 + vmax);
+         glVertex3f(-0.5, 0.5, 0.5);
+         glTexCoord2f(1.0 + umax, 0.0 + vmax);
+         glVertex3f(0.5, 0.5, 0.5);
+         glTexCoord2f(1.0 + umax, 1.0 + vmin);
+         glVertex3f(0.5, -0.5, 0.5);
+      glEnd();
+   }
 
 		// side 3
-   glNormal3f(-1.0, 0.0, 0.0);
-   glBegin(GL_TRIANGLES);
-      glTexCoord2f(0.0 + umin, 0.0 + vmax);
-      glVertex3f(-0.5, 0.5, -0.5);
-      glTexCoord2f(1.0 + umax, 1.0 + vmin);
-      glVertex3f(-0.5, -0.5, 0.5);
-      glTexCoord2f(0.0 + umin, 1.0 + vmin);
-      glVertex3f(-0.5, -0.5, -0.5);
-   glEnd();
-
-   glBegin(GL_TRIANGLES);
-      glTexCoord2f(0.0 + umin, 0.0 + vmax);
-      glVertex3f(-0.5, 0.5, -0.5);
-      glTexCoord2f(1.0 + umax, 0.0 + vmax);
-      glVertex3f(-0.5, 0.5, 0.5);
-      glTexCoord2f(1.0 + umax, 1.0 + vmin);
-      glVertex3f(-0.5, -0.5, 0.5);
-   glEnd();
+   if (faces & FACE_XNEG) {
+      glNormal3f(-1.0, 0.0, 0.0);
+      glBegin(GL_TRIANGLES);
+         glTexCoord2f(0.0 + umin, 0.0 + vmax);
+         glVertex3f(-0.5, 0.5, -0.5);
+         glTexCoord2f(1.0 + umax, 1.0 + vmin);
+         glVertex3f(-0.5, -0.5, 0.5);
+         glTexCoord2f(0.0 + umin, 1.0 + vmin);
+         glVertex3f(-0.5, -0.5, -0.5);
+      glEnd();
+
+      glBegin(GL_TRIANGLES);
+         glTexCoord2f(0.0 + umin, 0.0 + vmax);
+         glVertex3f(-0.5, 0.5, -0.5);
+         glTexCoord2f(1.0 + umax, 0.0 + vmax);
+         glVertex3f(-0.5, 0.5, 0.5);
+         glTexCoord2f(1.0 + umax, 1.0 + vmin);
+         glVertex3f(-0.5, -0.5, 0.5);
+      glEnd();
+   }
 
 		// side 4
-   glNormal3f(0.0, 0.0, -1.0);
-   glBegin(GL_TRIANGLES);
-      glTexCoord2f(0.0 + umin, 0.0 + vmax);
-      glVertex3f(0.5, 0.5, -0.5);
-      glTexCoord2f(1.0 + umax, 1.0 + vmin);
-      glVertex3f(-0.5, -0.5, -0.5);
-      glTexCoord2f(0.0 + umin, 1.0 + vmin);
-      glVertex3f(0.5, -0.5, -0.5);
-   glEnd();
-
-   glBegin(GL_TRIANGLES);
-      glTexCoord2f(0.0 + umin, 0.0 + vmax);
-      glVertex3f(0.5, 0.5, -0.5);
-      glTexCoord2f(1.0 + umax, 0.0 + vmax);
-      glVertex3f(-0.5, 0.5, -0.5);
-      glTexCoord2f(1.0 + umax, 1.0 + vmin);
-      glVertex3f(-0.5, -0.5, -0.5);
-   glEnd();
+   if (faces & FACE_ZNEG) {
+      glNormal3f(0.0, 0.0, -1.0);
+      glBegin(GL_TRIANGLES);
+         glTexCoord2f(0.0 + umin, 0.0 + vmax);
+         glVertex3f(0.5, 0.5, -0.5);
+         glTexCoord2f(1.0 + umax, 1.0 + vmin);
+         glVertex3f(-0.5, -0.5, -0.5);
+         glTexCoord2f(0.0 + umin, 1.0 + vmin);
+         glVertex3f(0.5, -0.5, -0.5);
+      glEnd();
+
+      glBegin(GL_TRIANGLES);
+         glTexCoord2f(0.0 + umin, 0.0 + vmax);
+         glVertex3f(0.5, 0.5, -0.5);
+         glTexCoord2f(1.0 + umax, 0.0 + vmax);
+         glVertex3f(-0.5, 0.5, -0.5);
+         glTexCoord2f(1.0 + umax, 1.0 + vmin);
+         glVertex3f(-0.5, -0.5, -0.5);
+      glEnd();
+   }
 
 		// side 5 - top
-   glNormal3f(0.0, 1.0, 0.0);
-   glBegin(GL_TRIANGLES);
-      glTexCoord2f(0.0 + umin, 0.0 + vmax);
-      glVertex3f(-0.5, 0.5, -0.5);
-      glTexCoord2f(1.0 + umax, 1.0 + vmin);
-      glVertex3f(0.5, 0.5, 0.5);
-      glTexCoord2f(0.0 + umin, 1.0 + vmin);
-      glVertex3f(-0.5, 0.5, 0.5);
-   glEnd();
-
-   glBegin(GL_TRIANGLES);
-      glTexCoord2f(0.0 + umin, 0.0 + vmax);
-      glVertex3f(-0.5, 0.5, -0.5);
-      glTexCoord2f(1.0 + umax, 0.0 + vmax);
-      glVertex3f(0.5, 0.5, -0.5);
-      glTexCoord2f(1.0 + umax, 1.0 + vmin);
-      glVertex3f(0.5, 0.5, 0.5);
-   glEnd();
+   if (faces & FACE_YPOS) {
+      glNormal3f(0.0, 1.0, 0.0);
+      glBegin(GL_TRIANGLES);
+         glTexCoord2f(0.0 + umin, 0.0 + vmax);
+         glVertex3f(-0.5, 0.5, -0.5);
+         glTexCoord2f(1.0 + umax, 1.0 + vmin);
+         glVertex3f(0.5, 0.5, 0.5);
+         glTexCoord2f(0.0 + umin, 1.0 + vmin);
+         glVertex3f(-0.5, 0.5, 0.5);
+      glEnd();
+
+      glBegin(GL_TRIANGLES);
+         glTexCoord2f(0.0 + umin, 0.0 + vmax);
+         glVertex3f(-0.5, 0.5, -0.5);
+         glTexCoord2f(1.0 + umax, 0.0 + vmax);
+         glVertex3f(0.5, 0.5, -0.5);
+         glTexCoord2f(1.0 + umax, 1.0 + vmin);
+         glVertex3f(0.5, 0.5, 0.5);
+      glEnd();
+   }
 
 		// side 6 - bottom
-   glNormal3f(0.0, -1.0, 0.0);
-   glBegin(GL_TRIANGLES);
-      glTexCoord2f(0.0 + umin, 0.0 + vmax);
-      glVertex3f(-0.5, -0.5, 0.5);
-      glTexCoord2f(1.0 + umax, 1.0 + vmin);
-      glVertex3f(0.5, -0.5, -0.5);
-      glTexCoord2f(0.0 + umin, 1.0 + vmin);
-      glVertex3f(-0.5, -0.5, -0.5);
-   glEnd();
-
-   glBegin(GL_TRIANGLES);
-      glTexCoord2f(0.0 + umin, 0.0 + vmax);
-      glVertex3f(-0.5, -0.5, 0.5);
-      glTexCoord2f(1.0 + umax, 0.0 + vmax);
-      glVertex3f(0.5, -0.5, 0.5);
-      glTexCoord2f(1.0 + umax, 1.0 + vmin);
-      glVertex3f(0.5, -0.5, -0.5);
-   glEnd();
+   if (faces & FACE_YNEG) {
+      glNormal3f(0.0, -1.0, 0.0);
+      glBegin(GL_TRIANGLES);
+         glTexCoord2f(0.0 + umin, 0.0 + vmax);
+         glVertex3f(-0.5, -0.5, 0.5);
+         glTexCoord2f(1.0 + umax, 1.0 + vmin);
+         glVertex3f(0.5, -0.5, -0.5);
+         glTexCoord2f(0.0 + umin, 1.0 + vmin);
+         glVertex3f(-0.5, -0.5, -0.5);
+      glEnd();
+
+      glBegin(GL_TRIANGLES);
+         glTexCoord2f(0.0 + umin, 0.0 + vmax);
+         glVertex3f(-0.5, -0.5, 0.5);
+         glTexCoord2f(1.0 + umax, 0.0 + vmax);
+         glVertex3f(0.5, -0.5, 0.5);
+         glTexCoord2f(1.0 + umax, 1.0 + vmin);
+         glVertex3f(0.5, -0.5, -0.5);
+      glEnd();
+   }
 
-   unsetObjectTexture(world[i][j][k]);
+   unsetObjectTexture(worldGet(i, j, k));
 
    glPopMatrix ();
 }
 
 
 
+	/* glutSolidCube() and glutSolidSphere() can't be used without */
+	/* GLUT, which is not started when drawing offscreen for -bench */
+static void solidCube(GLdouble size) {
+GLfloat h = size / 2.0;
+
+   if (benchMode == 0) {
+      glutSolidCube(size);
+      return;
+   }
+   glBegin(GL_QUADS);
+      glNormal3f(1.0, 0.0, 0.0);
+      glVertex3f(h, -h, h);
+      glVertex3f(h, -h, -h);
+      glVertex3f(h, h, -h);
+      glVertex3f(h, h, h);
+      glNormal3f(-1.0, 0.0, 0.0);
+      glVertex3f(-h, -h, -h);
+      glVertex3f(-h, -h, h);
+      glVertex3f(-h, h, h);
+      glVertex3f(-h, h, -h);
+      glNormal3f(0.0, 1.0, 0.0);
+      glVertex3f(-h, h, h);
+      glVertex3f(h, h, h);
+      glVertex3f(h, h, -h);
+      glVertex3f(-h, h, -h);
+      glNormal3f(0.0, -1.0, 0.0);
+      glVertex3f(-h, -h, -h);
+      glVertex3f(h, -h, -h);
+      glVertex3f(h, -h, h);
+      glVertex3f(-h, -h, h);
+      glNormal3f(0.0, 0.0, 1.0);
+      glVertex3f(-h, -h, h);
+      glVertex3f(h, -h, h);
+      glVertex3f(h, h, h);
+      glVertex3f(-h, h, h);
+      glNormal3f(0.0, 0.0, -1.0);
+      glVertex3f(h, -h, -h);
+      glVertex3f(-h, -h, -h);
+      glVertex3f(-h, h, -h);
+      glVertex3f(h, h, -h);
+   glEnd();
+}
+
+static void solidSphere(GLdouble radius, GLint slices, GLint stacks) {
+static GLUquadric *quadric = NULL;
+
+   if (benchMode == 0) {
+      glutSolidSphere(radius, slices, stacks);
+      return;
+   }
+   if (quadric == NULL)
+      quadric = gluNewQuadric();
+   gluSphere(quadric, radius, slices, stacks);
+}
+
 	/* called each time the world is redrawn */
 void display (void)
 {
@@ -693,26 +972,27 @@ int meshNumber;
 
 	/* position viewpoint based on mouse rotation and keyboard 
 	   translation */
-   glLoadIdentity();
-
+	/* the view matrix is built on the CPU so culling can use it */
+	/* without reading it back from OpenGL */
    if (fixedVP) {
 	// Fixed position - mvx =90; mvy =0; mvz =0;
 	// vpx =-50; vpy =-98; vpz =-50;
-      glRotatef(90.0, 1.0, 0.0, 0.0);
-      glRotatef(0.0, 0.0, 1.0, 0.0);
-      glRotatef(0.0, 0.0, 0.0, 1.0);
-      glTranslatef(-50.0, -98.0, -50.0);
+      cameraView(90.0, 0.0, 0.0, -50.0, -98.0, -50.0);
    } else {
-      glRotatef(mvx, 1.0, 0.0, 0.0);
-      glRotatef(mvy, 0.0, 1.0, 0.0);
-      glRotatef(mvz, 0.0, 0.0, 1.0);
 	/* Subtract 0.5 to raise viewpoint slightly above objects. */
 	/* Gives the impression of a head on top of a body. */
-      glTranslatef(vpx, vpy - 0.5, vpz);
-   //   glTranslatef(vpx, vpy, vpz);
+      cameraView(mvx, mvy, mvz, vpx, vpy - 0.5, vpz);
+   //   cameraView(mvx, mvy, mvz, vpx, vpy, vpz);
    }
+   glLoadMatrixf(cameraViewMatrix());
+
+	/* remesh any chunks whose cubes have changed */
+   profileBegin(PROF_CULL);
+   if (chunkRendering == 1)
+      updateChunks();
 
    buildDisplayList();
+   profileEnd(PROF_CULL);
 
 
 	/* set viewpoint light position */
@@ -750,13 +1030,15 @@ int meshNumber;
 	/* move the sky cube center to middle of world space */
    glTranslatef((float)WORLDX/2.0, (float)WORLDY/2.0, (float)WORLDZ/2.0);
    //glutSolidCube(150.0);
-   glutSolidCube(skySize);
+   solidCube(skySize);
+   frameStats.drawCalls++;
    glPopMatrix ();
    glShadeModel(GL_SMOOTH);
 	/* turn off emision lighting, use only for sky */
    glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, black);
 
 	/* draw mobs in the world */
+   profileBegin(PROF_MESHES);
    for(i=0; i<MOB_COUNT; i++) {
       if (mobVisible[i] == 1) {
          glPushMatrix();
@@ -765,15 +1047,17 @@ int meshNumber;
                mobPosition[i][2]+0.5);
          glMaterialfv(GL_FRONT, GL_AMBIENT, black);
          glMaterialfv(GL_FRONT, GL_DIFFUSE, gray);
-         glutSolidSphere(0.5, 8, 8);
+         solidSphere(0.5, 8, 8);
 		/* white eyes */
          glRotatef(mobPosition[i][3], 0.0, 1.0, 0.0);
          glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, white);
          glTranslatef(0.3, 0.1, 0.3);
-         glutSolidSphere(0.1, 4, 4);
+         solidSphere(0.1, 4, 4);
          glTranslatef(-0.6, 0.0, 0.0);
-         glutSolidSphere(0.1, 4, 4);
+         solidSphere(0.1, 4, 4);
          glPopMatrix();
+         frameStats.materialChanges += 2;
+         frameStats.drawCalls += 3;
       }
    }
 
@@ -809,9 +1093,13 @@ int meshNumber;
             glTexCoordPointer(2, GL_FLOAT, 0, meshobj[meshNumber].stdata);
             glEnable(GL_TEXTURE_2D);
             glBindTexture(GL_TEXTURE_2D, meshtextureID[meshNumber]);
+            frameStats.textureChanges++;
          }
 
          glDrawArrays(GL_TRIANGLES, 0, meshobj[meshNumber].icount * 3);
+         frameStats.meshes++;
+         frameStats.materialChanges++;
+         frameStats.drawCalls++;
 
          glDisableClientState(GL_VERTEX_ARRAY);
          if (meshobj[0].ncount > 1)
@@ -834,15 +1122,17 @@ int meshNumber;
                playerPosition[i][2]+0.5);
          glMaterialfv(GL_FRONT, GL_AMBIENT, white);
          glMaterialfv(GL_FRONT, GL_DIFFUSE, gray);
-         glutSolidSphere(0.5, 8, 8);
+         solidSphere(0.5, 8, 8);
 		/* white eyes */
          glRotatef(playerPosition[i][3], 0.0, 1.0, 0.0);
          glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, red);
          glTranslatef(0.3, 0.1, 0.3);
-         glutSolidSphere(0.1, 4, 4);
+         solidSphere(0.1, 4, 4);
          glTranslatef(-0.6, 0.0, 0.0);
-         glutSolidSphere(0.1, 4, 4);
+         solidSphere(0.1, 4, 4);
          glPopMatrix();
+         frameStats.materialChanges += 2;
+         frameStats.drawCalls += 3;
       }
    }
 
@@ -869,31 +1159,50 @@ int meshNumber;
          glVertex3f(tubeData[i][3], tubeData[i][4], tubeData[i][5]-0.1);
          glEnd();
          glPopMatrix();
+         frameStats.drawCalls++;
       }
    }
+   profileEnd(PROF_MESHES);
 
 	/* draw all cubes in the world array */
-   if (displayAllCubes == 1) {
+	/* world materials are cached until endWorldState() */
+   profileBegin(PROF_CUBES);
+   beginWorldState();
+   if ((displayAllCubes == 1) && (chunkRendering == 1)) {
+	/* draw all chunks */
+      chunkDisplayCount = 0;
+      for(i=0; i<CHUNKX; i++)
+         for(j=0; j<CHUNKY; j++)
+            for(k=0; k<CHUNKZ; k++)
+               addChunkDisplayList(i, j, k);
+      drawChunkList(chunkDisplayList, chunkDisplayCount);
+   } else if (displayAllCubes == 1) {
 	/* draw all cubes */
       for(i=0; i<WORLDX; i++) {
          for(j=0; j<WORLDY; j++) {
             for(k=0; k<WORLDZ; k++) {
-               if (world[i][j][k] != 0) {
+               if (worldGet(i, j, k) != 0) {
                   drawCube(i, j, k);
                }
             }
          }
       }
+   } else if (chunkRendering == 1) {
+	/* draw only the chunks in the chunkDisplayList */
+      drawChunkList(chunkDisplayList, chunkDisplayCount);
    } else {
 	/* draw only the cubes in the displayList */
 	/* these should have been selected in the update function */
+	/* and sorted by colour */
 
       for(i=0; i<displayCount; i++) {
-         drawCube(displayList[i][0],
-                  displayList[i][1],
-                  displayList[i][2]);
+         drawCube(CUBEX(displayList[i]),
+                  CUBEY(displayList[i]),
+                  CUBEZ(displayList[i]));
       }
    }
+   endWorldState();
+   profileEnd(PROF_CUBES);
 
 
 
@@ -913,7 +1222,14 @@ int meshNumber;
    glNormal3f(0.0, 0.0, -1.0);
 
 	/* call user's 2D drawing function */
+   profileBegin(PROF_2D);
    draw2D();
+   profileEnd(PROF_2D);
+
+	/* frame profiler and render statistics overlays, drawn over */
+	/* the user's 2D */
+   profileDraw();
+   statsDraw();
 
 	/* reset graphics for 3D drawing */
    glDisable(GL_BLEND);
@@ -925,7 +1241,19 @@ int meshNumber;
    glPopMatrix();
 	/* end 2d display code */
 
-   glutSwapBuffers();
+	/* hand this frame's phase times to the profiler and tracer */
+	/* and finish counting its render statistics */
+   profileFrame();
+   traceFrame();
+   statsFrame();
+
+	/* save the viewpoint as a pose of a benchmark camera path */
+   if (recordFile != NULL)
+      benchRecord(recordFile);
+
+	/* there is nothing to swap when drawing offscreen */
+   if (benchMode == 0)
+      glutSwapBuffers();
 }
 
 	/* sets viewport information */
@@ -933,9 +1261,9 @@ void reshape(int w, int h)
 {
    glViewport (0, 0, (GLsizei) w, (GLsizei) h);
    glMatrixMode (GL_PROJECTION);
-   glLoadIdentity ();
 	/* use skySize for far clipping plane */
-   gluPerspective(45.0, (GLfloat)w/(GLfloat)h, 0.1, skySize*1.5);
+   cameraPerspective(45.0, (GLfloat)w/(GLfloat)h, 0.1, skySize*1.5);
+   glLoadMatrixf(cameraProjectionMatrix());
    glMatrixMode (GL_MODELVIEW);
    glLoadIdentity ();
 	/* set global screen width and height */
@@ -1055,6 +1383,18 @@ static int lighton = 1;
          if (displayMap > 2)
             displayMap = 0;
          break;
+      case 'p':		// toggle frame profiler overlay, 0=off, 1=on
+         if (showProfile == 0)
+            showProfile = 1;
+         else
+            showProfile = 0;
+         break;
+      case 'i':		// toggle render statistics overlay, 0=off, 1=on
+         if (showStats == 0)
+            showStats = 1;
+         else
+            showStats = 0;
+         break;
       case '0':		// toggle viewpoint motion, 0=on, 1=off
          if (fixedVP == 0)
             fixedVP = 1;
@@ -1316,15 +1656,93 @@ void passivemotion(int x, int y) {
 
 
 
+	/* copy every loaded cube texture into a single atlas texture */
+	/* each texture is surrounded by ATLASPAD texels copied from the */
+	/* opposite edge so linear filtering matches GL_REPEAT */
+void buildTextureAtlas() {
+int i, x, y, count, cols, tile, size, maxSize;
+int wd[NUMBERTEXTURES], ht[NUMBERTEXTURES];
+GLubyte *atlas, *timage;
+
+	/* find the textures which were loaded and their sizes */
+   count = 0;
+   for(i=0; i<NUMBERTEXTURES; i++) {
+      if (textureUsed[i] == 1) {
+         glBindTexture(GL_TEXTURE_2D, textureID[i]);
+         glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &(wd[i]));
+         glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &(ht[i]));
+         count++;
+      }
+   }
+   if (count == 0) {
+      textureAtlas = 0;
+      return;
+   }
+
+	/* square grid of equal sized tiles */
+   tile = TEXTURESIZE + (2 * ATLASPAD);
+   cols = (int) ceil(sqrt((double) count));
+   size = cols * tile;
+   glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+   if (size > maxSize) {
+      printf("Texture atlas of size %d is too large, using separate textures.\n", size);
+      textureAtlas = 0;
+      return;
+   }
+
+   atlas = (GLubyte *) calloc(size * size * 4, sizeof(GLubyte));
+   timage = (GLubyte *) malloc(sizeof(GLubyte) * TEXTURESIZE * TEXTURESIZE * 4);
+   if ((atlas == NULL) || (timage == NULL)) {
+      printf("ERROR, could not allocate the texture atlas.\n");
+      exit(1);
+   }
+
+   glPixelStorei(GL_PACK_ALIGNMENT, 1);
+   count = 0;
+   for(i=0; i<NUMBERTEXTURES; i++) {
+      int ox, oy;
+      if (textureUsed[i] != 1)
+         continue;
+      ox = (count % cols) * tile;
+      oy = (count / cols) * tile;
+      count++;
+      glBindTexture(GL_TEXTURE_2D, textureID[i]);
+      glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, timage);
+	/* copy with wrapped borders */
+      for(y=-ATLASPAD; y<ht[i]+ATLASPAD; y++) {
+         for(x=-ATLASPAD; x<wd[i]+ATLASPAD; x++) {
+            int sx = (x + wd[i]) % wd[i];
+            int sy = (y + ht[i]) % ht[i];
+            memcpy(&(atlas[(((oy + ATLASPAD + y) * size) + ox + ATLASPAD + x) * 4]),
+               &(timage[((sy * wd[i]) + sx) * 4]), 4);
+         }
+      }
+      atlasRegion[i][0] = (float) (ox + ATLASPAD) / (float) size;
+      atlasRegion[i][1] = (float) (oy + ATLASPAD) / (float) size;
+      atlasRegion[i][2] = (float) wd[i] / (float) size;
+      atlasRegion[i][3] = (float) ht[i] / (float) size;
+   }
+
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+   glGenTextures(1, &atlasID);
+   glBindTexture(GL_TEXTURE_2D, atlasID);
+	/* wrapping is done by the padding, clamp at the atlas edges */
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size, size, 0, GL_RGBA,
+      GL_UNSIGNED_BYTE, atlas);
+
+   free(atlas);
+   free(timage);
+}
+
 	/* initilize graphics information and mob data structure */
 void graphicsInit(int *argc, char **argv) {
 int i, fullscreen;
 	// directory for textures
 char dirName[128];
-	/* set GL window information */
-   glutInit(argc, argv);
-   glutInitDisplayMode (GLUT_DOUBLE | GLUT_RGBA | GLUT_DEPTH);
-
 	/* parse command line args */
    fullscreen = 0;
    for(i=1; i<*argc; i++) {
@@ -1340,18 +1758,57 @@ char dirName[128];
          netClient = 1;
       if (strcmp(argv[i],"-server") == 0)
          netServer = 1;
+      if (strcmp(argv[i],"-cubes") == 0)
+         chunkRendering = 0;
+      if (strcmp(argv[i],"-atlas") == 0)
+         textureAtlas = 1;
+	/* the shader reads textures from the atlas */
+      if (strcmp(argv[i],"-shader") == 0) {
+         shaderRendering = 1;
+         textureAtlas = 1;
+      }
+      if (strcmp(argv[i],"-occlusion") == 0)
+         occlusionCulling = 1;
+      if (strcmp(argv[i],"-benchfrustum") == 0)
+         benchFrustum = 1;
+      if ((strcmp(argv[i],"-threads") == 0) && (i+1 < *argc))
+         cullThreads = atoi(argv[++i]);
+      if (strcmp(argv[i],"-bench") == 0)
+         benchMode = 1;
+      if (strcmp(argv[i],"-benchworld") == 0) {
+         benchMode = 1;
+         benchWorld = 1;
+      }
+      if ((strcmp(argv[i],"-record") == 0) && (i+1 < *argc))
+         recordFile = argv[++i];
+      if ((strcmp(argv[i],"-profile") == 0) && (i+1 < *argc))
+         profileFile = argv[++i];
+      if ((strcmp(argv[i],"-trace") == 0) && (i+1 < *argc))
+         traceFile = argv[++i];
+      if ((strcmp(argv[i],"-world") == 0) && (i+3 < *argc)) {
+         worldSizeX = atoi(argv[++i]);
+         worldSizeY = atoi(argv[++i]);
+         worldSizeZ = atoi(argv[++i]);
+      }
       if (strcmp(argv[i],"-help") == 0) {
-         printf("Usage: a4 [-full] [-drawall] [-testworld] [-fps] [-client] [-server]\n");
+         printf("Usage: a4 [-full] [-drawall] [-testworld] [-fps] [-client] [-server] [-cubes] [-atlas] [-shader] [-occlusion] [-benchfrustum] [-threads n] [-bench] [-benchworld] [-record file] [-profile file] [-trace file] [-world x y z]\n");
          exit(0);
       }
    }
 
-   if (fullscreen == 1) {
-      glutGameModeString("1024x768:32@75");
-      glutEnterGameMode();
+	/* set GL window information, -bench draws offscreen without GLUT */
+   if (benchMode == 1) {
+      benchInitContext(screenWidth, screenHeight);
    } else {
-      glutInitWindowSize (screenWidth, screenHeight);
-      glutCreateWindow (argv[0]);
+      glutInit(argc, argv);
+      glutInitDisplayMode (GLUT_DOUBLE | GLUT_RGBA | GLUT_DEPTH);
+      if (fullscreen == 1) {
+         glutGameModeString("1024x768:32@75");
+         glutEnterGameMode();
+      } else {
+         glutInitWindowSize (screenWidth, screenHeight);
+         glutCreateWindow (argv[0]);
+      }
    }
 
    init();
@@ -1370,6 +1827,16 @@ char dirName[128];
 	/* load textures for cubes */
    strcpy(dirName, "./textures/");
    loadTexture(dirName, textureID, &textureCount, textureUsed);
+	/* pack them into one texture for the chunk meshes */
+   if ((textureAtlas == 1) && (chunkRendering == 1))
+      buildTextureAtlas();
+   else
+      textureAtlas = 0;
+	/* use fixed function drawing if shaders can't be used */
+   if ((shaderRendering == 1) && ((textureAtlas == 0) || (initShader() != 0))) {
+      printf("Shaders not available, using fixed function drawing.\n");
+      shaderRendering = 0;
+   }
 
 	/* load textures for mesh */
    strcpy(dirName, "./models/");
@@ -1385,14 +1852,28 @@ char dirName[128];
 
 
 	/* attach functions to GL events */
-   glutReshapeFunc (reshape);
-   glutDisplayFunc(display);
-   glutKeyboardFunc (keyboard);
-   glutPassiveMotionFunc(passivemotion);
-   glutMotionFunc(motion);
-   glutMouseFunc(mouse);
-   glutIdleFunc(update);
+   if (benchMode == 0) {
+      glutReshapeFunc (reshape);
+      glutDisplayFunc(display);
+      glutKeyboardFunc (keyboard);
+      glutPassiveMotionFunc(passivemotion);
+      glutMotionFunc(motion);
+      glutMouseFunc(mouse);
+      glutIdleFunc(update);
+   }
+
 
+	/* allocate the world for the size chosen with -world, empty */
+   initWorld();
+   chunkDisplayList = malloc(sizeof(int) * 3 * CHUNKCOUNT);
+   if (chunkDisplayList == NULL) {
+      printf("Could not allocate the chunk display list.\n");
+      exit(1);
+   }
+   initCulling();
+
+	/* allocate chunk meshes for the world array */
+   initChunks();
 
 	/* initialize mob and player array to empty */
    initMobArray();
@@ -1445,6 +1926,22 @@ void  set2Dcolour(float colourv[]) {
    glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, colourv);
 }
 
+	/* start an overlay panel with a translucent background box from */
+	/* (x1,y1) to (x2,y2), the 2D shapes are all at the same depth so */
+	/* the depth test is off until end2Dpanel() to let the contents */
+	/* draw over the box and anything from draw2D() */
+void  begin2Dpanel(int x1, int y1, int x2, int y2) {
+GLfloat background[] = {0.0, 0.0, 0.0, 0.5};
+
+   glDisable(GL_DEPTH_TEST);
+   set2Dcolour(background);
+   draw2Dbox(x1, y1, x2, y2);
+}
+
+void  end2Dpanel() {
+   glEnable(GL_DEPTH_TEST);
+}
+
 
 
 	/* Functions for user defined colours */
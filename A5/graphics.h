@@ -11,13 +11,49 @@
 #include <GL/glut.h>
 #endif
 
-        /* world size and storage array */
-#define WORLDX 100
-#define WORLDY 50
-#define WORLDZ 100
+        /* world size, chosen at startup with -world x y z and fixed after */
+	/* graphicsInit(), the storage for it is allocated by initWorld() */
+#define WORLDDEFAULTX 100
+#define WORLDDEFAULTY 50
+#define WORLDDEFAULTZ 100
+extern int worldSizeX, worldSizeY, worldSizeZ;
+#define WORLDX worldSizeX
+#define WORLDY worldSizeY
+#define WORLDZ worldSizeZ
+	/* smallest world the floors can be built in, they start at y = 25 */
+	/* with the clouds on top and need room for a 3x3 grid of rooms */
+#define WORLDMINX 64
+#define WORLDMINY 50
+#define WORLDMINZ 64
 
-	/* list of cubes to draw with each screen update */
-#define MAX_DISPLAY_LIST 500000
+	/* world is split into CHUNKSIZE^3 chunks which are meshed together */
+#define CHUNKSIZE 16
+#define CHUNKX ((WORLDX + CHUNKSIZE - 1) / CHUNKSIZE)
+#define CHUNKY ((WORLDY + CHUNKSIZE - 1) / CHUNKSIZE)
+#define CHUNKZ ((WORLDZ + CHUNKSIZE - 1) / CHUNKSIZE)
+#define CHUNKCOUNT (CHUNKX * CHUNKY * CHUNKZ)
+	/* index of chunk (x,y,z) in arrays of CHUNKCOUNT chunks */
+#define CHUNKINDEX(x, y, z) (((x) * CHUNKY + (y)) * CHUNKZ + (z))
+
+	/* bits in faceMask[][][] for each exposed side of a cube */
+#define FACE_XPOS 0x01
+#define FACE_XNEG 0x02
+#define FACE_YPOS 0x04
+#define FACE_YNEG 0x08
+#define FACE_ZPOS 0x10
+#define FACE_ZNEG 0x20
+
+	/* cubes in the display list are packed into one unsigned int with */
+	/* DISPLAYBITS bits for each of x, y and z, z lowest */
+#define DISPLAYBITS 10
+#define DISPLAYMASK ((1 << DISPLAYBITS) - 1)
+#define PACKCUBE(x, y, z) (((unsigned int) (x) << (2 * DISPLAYBITS)) | \
+   ((unsigned int) (y) << DISPLAYBITS) | (unsigned int) (z))
+#define CUBEX(c) (((c) >> (2 * DISPLAYBITS)) & DISPLAYMASK)
+#define CUBEY(c) (((c) >> DISPLAYBITS) & DISPLAYMASK)
+#define CUBEZ(c) ((c) & DISPLAYMASK)
+	/* so -world can be no larger than this along any side */
+#define WORLDMAX (1 << DISPLAYBITS)
 
 	/* maximum number of user defined colours */
 #define NUMBERCOLOURS 100
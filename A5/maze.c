@@ -6,6 +6,17 @@
 
 #include "maze.h"
 #include "perlin.h"
+#include "portal.h"
+
+// Seed used when generating floors, 0 seeds from the clock instead
+unsigned int mazeSeed = 0;
+
+/*
+ * Seed the random number generator before generating a floor
+ */
+static void seedFloor(){
+    srand((mazeSeed != 0) ? mazeSeed : (unsigned int)time(NULL));
+}
 
 struct floor* initMaze(int floorWidth, int floorHeight, int floorType){
     struct floor* toRet;
@@ -28,8 +39,17 @@ struct floor* initMaze(int floorWidth, int floorHeight, int floorType){
     toRet->floorWidth = floorWidth;
     toRet->floorHeight = floorHeight;
     toRet->mobCount = 0; // Start with 0 mobs
+    toRet->itemCount = 0; // Start with 0 items
+    toRet->items = NULL;
     toRet->drawDist = 0.0; // Start with 0 draw dist
     toRet->hasKey = false;
+    toRet->regionCount = 0; // Portal graph is only built for dungeons
+    toRet->regions = NULL;
+    toRet->portalCount = 0;
+    toRet->portals = NULL;
+    toRet->regionMap = NULL;
+    toRet->pvsWidth = 0;
+    toRet->pvsHeight = 0;
 
     // Allocate floor data
     toRet->floorData = (char**)malloc(toRet->floorWidth * sizeof(char*));
@@ -44,23 +64,10 @@ struct floor* initMaze(int floorWidth, int floorHeight, int floorType){
         return NULL;
     }
 
-    // Init heightmap if outdoor level
+    // Outdoor levels have no height map, their terrain is streamed
     if(floorType==OUTSIDE){
         // Set that this is an outdoor map
         toRet->floorType = OUTSIDE;
-        for(i = 0; i < toRet->floorWidth; i++){
-            toRet->heightMap[i] = (float*)malloc(toRet->floorHeight * sizeof(float));
-            if(toRet->heightMap[i] == NULL){
-                fprintf(stderr, "ERROR: Height map for column %d could not be allocated! Aborting!", i);
-                // Attempt cleanup!
-                while(i>=0){
-                    free(toRet->heightMap[--i]);
-                }
-                free(toRet->heightMap);
-                free(toRet);
-                return NULL;
-            }
-        }
         genOutdoors(toRet);
         return toRet;
     } else if(floorType==CAVE){
@@ -197,7 +204,7 @@ void genMaze(struct floor* maze){
     int x, y;
     
     // Seed the random number generator
-    srand(time(NULL));
+    seedFloor();
     // First set entire maze to 'empty' space
     for(x = 0; x < maze->floorWidth; x++){
         for(y = 0; y < maze->floorHeight; y++){
@@ -227,6 +234,9 @@ void genMaze(struct floor* maze){
     // Enclose all corridors with walls
     wallOffHalls(maze);
 
+    // Build the room/door graph used for culling
+    genPortals(maze);
+
     // Populate the rooms (set player position, spawn mobs, drop loot, add decor, etc)
     populateFloor(maze);
 
@@ -237,22 +247,13 @@ void genOutdoors(struct floor* maze){
     if(DEBUG==0)
         printf("Generating outdoor world...\n");
 
-    int x, y;
-
     // Seed the random number generator
-    srand(time(NULL));
+    seedFloor();
     // Flag stairs as not placed
     maze->sx = -1;
     // Seed the perlin noise generator
     SEED = randRange(0, 4096);
-    
-    // Begin iterating over the heightmap
-    for(y = 0; y < maze->floorHeight; y++){
-        for(x = 0; x < maze->floorWidth; x++){
-            // Get a float value for this coordinate
-            maze->heightMap[x][y] = perlin2d((float)x, (float)y, 0.1, 1);
-        }
-    }
+    // The terrain itself is streamed in around the player by terrain.c
 
     return;
 }
@@ -272,7 +273,7 @@ void genCave(struct floor* maze){
         }
     }
     // Seed the random number generator
-    srand(time(NULL));
+    seedFloor();
     // Flag stairs as not placed
     maze->sx = -1;
     // Seed the perlin noise generator
@@ -292,8 +293,8 @@ void genCave(struct floor* maze){
 
     // Pick spots for stairs
     while(true){
-        pen.x = randRange(25, 75);
-        pen.y = randRange(25, 75);
+        pen.x = randRange(maze->floorWidth / 4, maze->floorWidth * 3 / 4);
+        pen.y = randRange(maze->floorHeight / 4, maze->floorHeight * 3 / 4);
         if(maze->floorEntities[pen.x][pen.y]==' '){
             maze->floorEntities[pen.x][pen.y] = 'U'; // Upstairs
             maze->floorEntities[pen.x+1][pen.y] = '@'; // Player
@@ -301,8 +302,8 @@ void genCave(struct floor* maze){
         }
     }
     while(true){
-        pen.x = randRange(25, 75);
-        pen.y = randRange(25, 75);
+        pen.x = randRange(maze->floorWidth / 4, maze->floorWidth * 3 / 4);
+        pen.y = randRange(maze->floorHeight / 4, maze->floorHeight * 3 / 4);
         if(maze->floorEntities[pen.x][pen.y]==' '){
             maze->floorEntities[pen.x][pen.y] = 'D'; // Downstairs
             break;
@@ -312,8 +313,8 @@ void genCave(struct floor* maze){
     // Place responsive mobs
     int numToPlace = randRange(2, 4);
     while(true){
-        pen.x = randRange(25, 75);
-        pen.y = randRange(25, 75);
+        pen.x = randRange(maze->floorWidth / 4, maze->floorWidth * 3 / 4);
+        pen.y = randRange(maze->floorHeight / 4, maze->floorHeight * 3 / 4);
         if(maze->floorEntities[pen.x][pen.y]==' '){
             maze->floorEntities[pen.x][pen.y] = 'F';
             maze->mobCount++;
@@ -327,8 +328,8 @@ void genCave(struct floor* maze){
     while(true){
         x = randRange(0, 2);
         y = randRange(0, 2);
-        pen.x = randRange(25, 75);
-        pen.y = randRange(25, 75);
+        pen.x = randRange(maze->floorWidth / 4, maze->floorWidth * 3 / 4);
+        pen.y = randRange(maze->floorHeight / 4, maze->floorHeight * 3 / 4);
         if(maze->floorEntities[pen.x][pen.y] == ' ' && !isBlockingDoor(maze, pen.x, pen.y)){
             maze->floorEntities[pen.x][pen.y] = 'K';
             maze->itemCount++;
@@ -364,10 +365,11 @@ void genCells(struct floor* maze){
     // Setup initial (even) cell borders
     if(DEBUG==0)
         printf("Initializing base cell borders...\n");
-    maze->vd1 = (int)(maze->floorWidth/3);
-    maze->vd2 = (int)((maze->floorWidth/3)*2);
-    maze->hd1 = (int)(maze->floorHeight/3);
-    maze->hd2 = (int)((maze->floorHeight/3)*2);
+    // hd* split the floor along x (floorWidth), vd* along y (floorHeight)
+    maze->hd1 = (int)(maze->floorWidth/3);
+    maze->hd2 = (int)((maze->floorWidth/3)*2);
+    maze->vd1 = (int)(maze->floorHeight/3);
+    maze->vd2 = (int)((maze->floorHeight/3)*2);
 
     // Offset even borders to make things more interesting
     if(DEBUG==0)
@@ -835,12 +837,12 @@ void printMaze(struct floor* maze){
 
 void freeMaze(struct floor* maze){
     int x;
-    if(maze->floorType==OUTSIDE){
+    if(maze->floorType==CAVE){
         for(x = 0; x < maze->floorWidth; x++){
             free(maze->heightMap[x]);
         }
-        free(maze->heightMap);
     }
+    free(maze->heightMap);
     for(x = 0; x < maze->floorWidth; x++){
         free(maze->floorData[x]);
         free(maze->floorEntities[x]);
@@ -851,6 +853,7 @@ void freeMaze(struct floor* maze){
         free(maze->rooms[x]);
     }
     free(maze->rooms);
+    freePortals(maze);
     free(maze);
     return;
 }
@@ -997,10 +1000,11 @@ void rectPatternFill(struct floor* maze, struct position p1, struct position p2,
 \*************************/
 
 struct TILE** initTileMap(struct floor* f){
-    struct TILE** tileMap = malloc(sizeof(struct TILE*) * f->floorHeight);
+    // Indexed [x][y] like the floor data
+    struct TILE** tileMap = malloc(sizeof(struct TILE*) * f->floorWidth);
     int i;
-    for(i = 0; i < f->floorHeight; i++){
-        tileMap[i] = malloc(sizeof(struct TILE) * f->floorWidth);
+    for(i = 0; i < f->floorWidth; i++){
+        tileMap[i] = malloc(sizeof(struct TILE) * f->floorHeight);
     }
 
     int x, y;
@@ -1108,9 +1112,9 @@ struct path* aStar(struct floor* f, struct position start, struct position end){
                 struct path* toRet;
                 toRet = buildPath(tileMap, &tileMap[start.x][start.y], s);
                 // CLEANUP
-                int y;
-                for(y = 0; y < f->floorHeight; y++){
-                    free(tileMap[y]);
+                int x;
+                for(x = 0; x < f->floorWidth; x++){
+                    free(tileMap[x]);
                 }
                 free(tileMap);
                 return toRet;
@@ -1174,7 +1178,8 @@ struct path* buildPath(struct TILE** tileMap, struct TILE* start, struct TILE* e
     for(i = size - 1; i >= 0; i--){
         toRet->points[i].x = t->pos.x;
         toRet->points[i].y = t->pos.y;
-        t = &tileMap[t->prev.x][t->prev.y];
+        // The start has no previous tile
+        if(i > 0) t = &tileMap[t->prev.x][t->prev.y];
     }
     return toRet;
 }
@@ -185,6 +185,30 @@ struct room {
     bool roomVisible;
 };
 
+/*
+ * Area of a DUNGEON floor used for portal culling, either a room or a
+ * connected run of corridor
+ */
+struct region {
+    // Floor tiles to draw when this region can be seen (includes its walls and doors)
+    struct position* tiles;
+    int tileCount;
+    // Doors leading out of this region (indices into the floor's portal list)
+    int* portals;
+    int portalCount;
+    // Potentially visible set, flags each chunk column which can be seen from anywhere in this region
+    bool* pvs;
+};
+
+/*
+ * Door tile joining two regions, visibility passes through it when the door is open ('|')
+ */
+struct portal {
+    struct position door;
+    int regionA;
+    int regionB;
+};
+
 /*
  * Struct that contains floor data
  */
@@ -204,12 +228,14 @@ struct floor {
     int floorHeight;
     // Max draw distance for this floor (Diagonal dist for the largest room)
     float drawDist;
-    // 3D Stair position for outdoor level
+    // 3D Stair position for outdoor level, x and z are in streamed terrain
+    // coordinates (see terrain.h)
     int sx, sy, sz;
-    // 3D position for player controller
+    // 3D position for player controller, the position the outdoor level
+    // is entered at has x and z in streamed terrain coordinates too
     int px, py, pz;
 
-    // 2D Float array holding heightmap data for the outside level
+    // 2D Float array holding heightmap data for the cave level
     float** heightMap;
     // 'Cell' dividers (room zones)
     int hd1, hd2, vd1, vd2;
@@ -225,6 +251,16 @@ struct floor {
     struct item* items;
     // 2D Struct array containing room data for this floor
     struct room** rooms;
+    // Portal graph used to cull DUNGEON floors (regions are rooms and corridors, portals are doors)
+    int regionCount;
+    struct region* regions;
+    int portalCount;
+    struct portal* portals;
+    // 2D Int array holding the region index for each tile (-1 for walls, doors and empty space)
+    int** regionMap;
+    // Size of the chunk column grid covering this floor (used to index region PVS flags)
+    int pvsWidth;
+    int pvsHeight;
 };
 
 /*
@@ -240,6 +276,13 @@ struct floor_stack {
     struct floor** floors;
 };
 
+/*
+ * Seed for the random number generator used when generating floors.
+ * The default of 0 seeds from the clock, anything else makes each floor
+ * the same from run to run.
+ */
+extern unsigned int mazeSeed;
+
 /*
  * Entry point function for maze generation. 
  * Creates and returns a character array representing one level
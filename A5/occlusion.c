@@ -0,0 +1,362 @@
+/* Coarse CPU depth buffer for occlusion culling */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "graphics.h"
+#include "occlusion.h"
+#include "world.h"
+#include "visible.h"
+#include "camera.h"
+
+
+// Longest run of solid cubes in each world column, top < bottom when the
+// column is empty.  Column (x,z) is at RUN(x, z).
+static int *runBottom = NULL;
+static int *runTop = NULL;
+#define RUN(x, z) ((x) * WORLDZ + (z))
+
+// Normalized device depth of the nearest occluder covering each pixel
+static float depthBuffer[OCCLUSIONH][OCCLUSIONW];
+
+// Combined modelview and projection matrix for the current frame
+static float clip[16];
+
+// Small amount a box must be in front of the buffer to count as visible,
+// covers rounding in the depth interpolation
+#define DEPTHBIAS 0.00001
+
+/*
+ * A vertex after transforming into clip space
+ */
+struct clipVertex {
+   float x, y, z, w;
+};
+
+void initOccluders(){
+   runBottom = calloc(WORLDX * WORLDZ, sizeof(int));
+   runTop = calloc(WORLDX * WORLDZ, sizeof(int));
+   if(runBottom == NULL || runTop == NULL){
+      fprintf(stderr, "ERROR: Could not allocate the occluder columns! Aborting!\n");
+      exit(1);
+   }
+}
+
+void updateOccluderColumn(int x, int z){
+   int y, start = -1;
+
+   if(x < 0 || z < 0 || x >= WORLDX || z >= WORLDZ){
+      return;
+   }
+   runBottom[RUN(x, z)] = 1;
+   runTop[RUN(x, z)] = 0;
+   // Only the occupied span of the column can hold a run
+   for(y = columnBottom(x, z); y <= columnTop(x, z) + 1; y++){
+      if(y <= columnTop(x, z) && worldGet(x, y, z) != 0){
+         if(start == -1){
+            start = y;
+         }
+      } else if(start != -1){
+         // Keep the tallest run, it hides the most
+         if(y - start > runTop[RUN(x, z)] - runBottom[RUN(x, z)] + 1){
+            runBottom[RUN(x, z)] = start;
+            runTop[RUN(x, z)] = y - 1;
+         }
+         start = -1;
+      }
+   }
+}
+
+void computeOccluders(){
+   int x, z;
+
+   for(x = 0; x < WORLDX; x++){
+      for(z = 0; z < WORLDZ; z++){
+         updateOccluderColumn(x, z);
+      }
+   }
+}
+
+/*
+ * Move a world point into clip space
+ */
+static struct clipVertex toClip(float x, float y, float z){
+   struct clipVertex v;
+
+   v.x = x * clip[0] + y * clip[4] + z * clip[8] + clip[12];
+   v.y = x * clip[1] + y * clip[5] + z * clip[9] + clip[13];
+   v.z = x * clip[2] + y * clip[6] + z * clip[10] + clip[14];
+   v.w = x * clip[3] + y * clip[7] + z * clip[11] + clip[15];
+   return v;
+}
+
+/*
+ * Signed area test of point (px,py) against the edge from a to b, positive
+ * on the inside of a polygon wound with a positive area
+ */
+static float edgeSide(float *a, float *b, float px, float py){
+   return (b[0] - a[0]) * (py - a[1]) - (b[1] - a[1]) * (px - a[0]);
+}
+
+/*
+ * Fill a convex screen space polygon (buffer pixel coordinates plus device
+ * depth) into the depth buffer.  Only pixels the polygon covers completely
+ * are filled, and each gets the farthest depth of the polygon across it,
+ * so a pixel is never nearer in the buffer than what is really drawn there
+ */
+static void rasterPolygon(float v[][3], int n){
+   int i, k, x, y, x0, x1, y0, y1, inside;
+   float area = 0.0, best = 0.0, sign, w0, w1, depth, corner;
+   float *a, *b = NULL, *c = NULL;
+
+   for(i = 0; i < n; i++){
+      area += v[i][0] * v[(i + 1) % n][1] - v[(i + 1) % n][0] * v[i][1];
+   }
+   if(fabs(area) < 0.000001){
+      return;
+   }
+   sign = (area > 0) ? 1.0 : -1.0;
+
+   // Depth is a plane across the polygon, take it from its largest
+   // triangle so the weights are well conditioned
+   a = v[0];
+   for(i = 1; i < n - 1; i++){
+      float t = fabs(edgeSide(a, v[i], v[i + 1][0], v[i + 1][1]));
+      if(t > best){
+         best = t;
+         b = v[i];
+         c = v[i + 1];
+      }
+   }
+   area = edgeSide(a, b, c[0], c[1]);
+
+   x0 = x1 = (int)floor(v[0][0]);
+   y0 = y1 = (int)floor(v[0][1]);
+   for(i = 1; i < n; i++){
+      if(v[i][0] < x0) x0 = (int)floor(v[i][0]);
+      if(v[i][0] > x1) x1 = (int)floor(v[i][0]);
+      if(v[i][1] < y0) y0 = (int)floor(v[i][1]);
+      if(v[i][1] > y1) y1 = (int)floor(v[i][1]);
+   }
+   if(x0 < 0) x0 = 0;
+   if(y0 < 0) y0 = 0;
+   if(x1 > OCCLUSIONW - 1) x1 = OCCLUSIONW - 1;
+   if(y1 > OCCLUSIONH - 1) y1 = OCCLUSIONH - 1;
+
+   for(y = y0; y <= y1; y++){
+      for(x = x0; x <= x1; x++){
+         // All four corners of the pixel must be inside every edge
+         inside = 1;
+         for(i = 0; i < n && inside; i++){
+            for(k = 0; k < 4; k++){
+               if(sign * edgeSide(v[i], v[(i + 1) % n], x + (k & 1),
+                     y + (k >> 1)) < 0){
+                  inside = 0;
+                  break;
+               }
+            }
+         }
+         if(!inside){
+            continue;
+         }
+         // The plane is farthest at one of the corners
+         depth = -1.0;
+         for(k = 0; k < 4; k++){
+            w0 = edgeSide(b, c, x + (k & 1), y + (k >> 1)) / area;
+            w1 = edgeSide(c, a, x + (k & 1), y + (k >> 1)) / area;
+            corner = w0 * a[2] + w1 * b[2] + (1.0 - w0 - w1) * c[2];
+            if(corner > depth){
+               depth = corner;
+            }
+         }
+         if(depth < depthBuffer[y][x]){
+            depthBuffer[y][x] = depth;
+         }
+      }
+   }
+}
+
+/*
+ * Clip a world space quad against the near plane and fill it into the
+ * depth buffer
+ */
+static void rasterQuad(float quad[4][3]){
+   struct clipVertex in[4], out[5];
+   float screen[5][3];
+   int i, n = 0;
+
+   for(i = 0; i < 4; i++){
+      in[i] = toClip(quad[i][0], quad[i][1], quad[i][2]);
+   }
+   // Sutherland-Hodgman against z >= -w
+   for(i = 0; i < 4; i++){
+      struct clipVertex p = in[i];
+      struct clipVertex q = in[(i + 1) % 4];
+      float dp = p.z + p.w;
+      float dq = q.z + q.w;
+      if(dp >= 0){
+         out[n++] = p;
+      }
+      if((dp >= 0) != (dq >= 0)){
+         float t = dp / (dp - dq);
+         out[n].x = p.x + (q.x - p.x) * t;
+         out[n].y = p.y + (q.y - p.y) * t;
+         out[n].z = p.z + (q.z - p.z) * t;
+         out[n].w = p.w + (q.w - p.w) * t;
+         n++;
+      }
+   }
+   if(n < 3){
+      return;
+   }
+   for(i = 0; i < n; i++){
+      if(out[i].w <= 0.0){
+         return;
+      }
+      screen[i][0] = (out[i].x / out[i].w * 0.5 + 0.5) * OCCLUSIONW;
+      screen[i][1] = (out[i].y / out[i].w * 0.5 + 0.5) * OCCLUSIONH;
+      screen[i][2] = out[i].z / out[i].w;
+   }
+   // The whole quad at once, split into triangles the pixels along the
+   // diagonal would be covered by neither
+   rasterPolygon(screen, n);
+}
+
+/*
+ * Returns true if the run of column (x,z) fully covers the height from
+ * bottom to top, so a face against it is buried
+ */
+static int runCovers(int x, int z, int bottom, int top){
+   if(x < 0 || z < 0 || x >= WORLDX || z >= WORLDZ){
+      return 0;
+   }
+   return (runBottom[RUN(x, z)] <= bottom) && (runTop[RUN(x, z)] >= top);
+}
+
+/*
+ * Fill the faces of the run in column (x,z) which face the viewpoint
+ */
+static void rasterColumn(int x, int z, float vx, float vy, float vz){
+   float b = runBottom[RUN(x, z)];
+   float t = runTop[RUN(x, z)] + 1;
+   float quad[4][3];
+
+   // Top and bottom
+   if(vy > t){
+      float q[4][3] = {{x, t, z}, {x + 1, t, z}, {x + 1, t, z + 1}, {x, t, z + 1}};
+      memcpy(quad, q, sizeof(quad));
+      rasterQuad(quad);
+   } else if(vy < b){
+      float q[4][3] = {{x, b, z}, {x + 1, b, z}, {x + 1, b, z + 1}, {x, b, z + 1}};
+      memcpy(quad, q, sizeof(quad));
+      rasterQuad(quad);
+   }
+   // Sides, skipped when the neighbouring run buries them
+   if(vx > x + 1 && !runCovers(x + 1, z, runBottom[RUN(x, z)], runTop[RUN(x, z)])){
+      float q[4][3] = {{x + 1, b, z}, {x + 1, t, z}, {x + 1, t, z + 1}, {x + 1, b, z + 1}};
+      memcpy(quad, q, sizeof(quad));
+      rasterQuad(quad);
+   } else if(vx < x && !runCovers(x - 1, z, runBottom[RUN(x, z)], runTop[RUN(x, z)])){
+      float q[4][3] = {{x, b, z}, {x, t, z}, {x, t, z + 1}, {x, b, z + 1}};
+      memcpy(quad, q, sizeof(quad));
+      rasterQuad(quad);
+   }
+   if(vz > z + 1 && !runCovers(x, z + 1, runBottom[RUN(x, z)], runTop[RUN(x, z)])){
+      float q[4][3] = {{x, b, z + 1}, {x + 1, b, z + 1}, {x + 1, t, z + 1}, {x, t, z + 1}};
+      memcpy(quad, q, sizeof(quad));
+      rasterQuad(quad);
+   } else if(vz < z && !runCovers(x, z - 1, runBottom[RUN(x, z)], runTop[RUN(x, z)])){
+      float q[4][3] = {{x, b, z}, {x + 1, b, z}, {x + 1, t, z}, {x, t, z}};
+      memcpy(quad, q, sizeof(quad));
+      rasterQuad(quad);
+   }
+}
+
+void buildOcclusionBuffer(float vx, float vy, float vz){
+   int i, j, x, z, x0, x1, z0, z1;
+
+   memcpy(clip, cameraClipMatrix(), sizeof(clip));
+
+   for(i = 0; i < OCCLUSIONH; i++){
+      for(j = 0; j < OCCLUSIONW; j++){
+         depthBuffer[i][j] = 1.0;
+      }
+   }
+
+   // Faces are all seen from behind when the viewpoint is inside a solid
+   // column, leave the buffer empty so nothing is culled
+   x = (int)floor(vx);
+   z = (int)floor(vz);
+   if(x >= 0 && z >= 0 && x < WORLDX && z < WORLDZ
+         && vy >= runBottom[RUN(x, z)] && vy < runTop[RUN(x, z)] + 1){
+      return;
+   }
+
+   // Columns around the viewpoint which are on screen
+   x0 = (int)vx - OCCLUSIONRANGE;
+   x1 = (int)vx + OCCLUSIONRANGE;
+   z0 = (int)vz - OCCLUSIONRANGE;
+   z1 = (int)vz + OCCLUSIONRANGE;
+   if(x0 < 0) x0 = 0;
+   if(z0 < 0) z0 = 0;
+   if(x1 > WORLDX - 1) x1 = WORLDX - 1;
+   if(z1 > WORLDZ - 1) z1 = WORLDZ - 1;
+   for(x = x0; x <= x1; x++){
+      for(z = z0; z <= z1; z++){
+         float half;
+         if(runTop[RUN(x, z)] < runBottom[RUN(x, z)]){
+            continue;
+         }
+         half = (runTop[RUN(x, z)] - runBottom[RUN(x, z)] + 1) / 2.0;
+         if(!CubeInFrustum(x + 0.5, runBottom[RUN(x, z)] + half, z + 0.5, half)){
+            continue;
+         }
+         rasterColumn(x, z, vx, vy, vz);
+      }
+   }
+}
+
+int boxOccluded(float x0, float y0, float z0, float x1, float y1, float z1){
+   int i, x, y, px0, px1, py0, py1;
+   float sx0 = OCCLUSIONW, sx1 = -1, sy0 = OCCLUSIONH, sy1 = -1, nearest = 1.0;
+
+   for(i = 0; i < 8; i++){
+      struct clipVertex v = toClip((i & 1) ? x1 : x0, (i & 2) ? y1 : y0, (i & 4) ? z1 : z0);
+      float sx, sy, sz;
+      // Anything reaching past the near plane is treated as visible
+      if(v.w <= 0.0 || v.z < -v.w){
+         return 0;
+      }
+      sx = (v.x / v.w * 0.5 + 0.5) * OCCLUSIONW;
+      sy = (v.y / v.w * 0.5 + 0.5) * OCCLUSIONH;
+      sz = v.z / v.w;
+      if(sx < sx0) sx0 = sx;
+      if(sx > sx1) sx1 = sx;
+      if(sy < sy0) sy0 = sy;
+      if(sy > sy1) sy1 = sy;
+      if(sz < nearest) nearest = sz;
+   }
+
+   // Every pixel the box touches must have a nearer occluder
+   px0 = (int)floor(sx0);
+   px1 = (int)floor(sx1);
+   py0 = (int)floor(sy0);
+   py1 = (int)floor(sy1);
+   if(px0 < 0) px0 = 0;
+   if(py0 < 0) py0 = 0;
+   if(px1 > OCCLUSIONW - 1) px1 = OCCLUSIONW - 1;
+   if(py1 > OCCLUSIONH - 1) py1 = OCCLUSIONH - 1;
+   if(px0 > px1 || py0 > py1){
+      return 0;
+   }
+   for(y = py0; y <= py1; y++){
+      for(x = px0; x <= px1; x++){
+         if(depthBuffer[y][x] >= nearest - DEPTHBIAS){
+            return 0;
+         }
+      }
+   }
+   return 1;
+}
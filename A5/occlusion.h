@@ -0,0 +1,42 @@
+/*
+ * Coarse software depth buffer used for occlusion culling.
+ * Each frame the solid runs of the world columns near the viewpoint are
+ * rasterized into a small CPU depth buffer.  Boxes (cubes, octree nodes and
+ * chunks) which are behind that depth everywhere they cover on screen are
+ * hidden and do not need to be drawn.
+ */
+
+	/* size of the CPU depth buffer, the whole window maps onto it */
+#define OCCLUSIONW 160
+#define OCCLUSIONH 120
+	/* columns within this many cubes of the viewpoint are used as occluders */
+#define OCCLUSIONRANGE 48
+
+/*
+ * Allocate the solid run of every world column, called by initWorld()
+ */
+void initOccluders();
+
+/*
+ * Rebuild the solid run of every world column, call after the world array
+ * has been filled in
+ */
+void computeOccluders();
+
+/*
+ * Rebuild the solid run of the world column at (x,z) after a cube changed
+ */
+void updateOccluderColumn(int x, int z);
+
+/*
+ * Clear the depth buffer and rasterize the occluders around the viewpoint
+ * (x,y,z), in world coordinates.  Uses the matrices from camera.c and the
+ * frustum from ExtractFrustum().
+ */
+void buildOcclusionBuffer(float x, float y, float z);
+
+/*
+ * Returns 1 if the box from (x0,y0,z0) to (x1,y1,z1) is hidden behind the
+ * occluders in the depth buffer
+ */
+int boxOccluded(float x0, float y0, float z0, float x1, float y1, float z1);
@@ -3,13 +3,17 @@
  */
 
 #include <stdio.h>
+#include <math.h>
 
 #include "perlin.h"
 
+// Masked rather than taken % 256 so negative coordinates (the streamed
+// outdoor terrain goes both ways from 0) wrap instead of indexing before
+// the table, the same for coordinates of 0 and up
 int noise2(int x, int y)
 {
-    int tmp = hash[(y + SEED) % 256];
-    return hash[(tmp + x) % 256];
+    int tmp = hash[(y + SEED) & 255];
+    return hash[(tmp + x) & 255];
 }
 
 float lin_inter(float x, float y, float s)
@@ -24,8 +28,8 @@ float smooth_inter(float x, float y, float s)
 
 float noise2d(float x, float y)
 {
-    int x_int = x;
-    int y_int = y;
+    int x_int = floorf(x);
+    int y_int = floorf(y);
     float x_frac = x - x_int;
     float y_frac = y - y_int;
     int s = noise2(x_int, y_int);
@@ -0,0 +1,414 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "graphics.h"
+#include "maze.h"
+#include "portal.h"
+#include "visible.h"
+
+// Floor being culled and the world height of its floor tiles
+static struct floor* portalFloor = NULL;
+static int portalBase = 0;
+// Highest wall top above the floor tiles, above this the player is outside the rooms
+static int portalTop = 0;
+
+// Number of rays cast from each sample tile when building the PVS
+#define PVSRAYS 256
+
+// Result of the last portalCull(), column (x,z) is at x * WORLDZ + z and
+// chunk column (x,z) at x * CHUNKZ + z
+static GLubyte* columnVisible = NULL;
+static GLubyte* chunkVisible = NULL;
+// Chunk columns in the PVS of the player's region, as a list and flagged
+// at x * CHUNKZ + z
+static int (*pvsList)[2] = NULL;
+static bool* pvsColumns = NULL;
+static int pvsCount = 0;
+
+/*
+ * Add a tile to a region's draw list
+ */
+static void addRegionTile(struct region* r, int x, int y){
+    if(r->tileCount % 64 == 0){
+        r->tiles = realloc(r->tiles, sizeof(struct position) * (r->tileCount + 64));
+        if(r->tiles == NULL){
+            fprintf(stderr, "ERROR: Could not grow region tile list! Aborting!\n");
+            exit(1);
+        }
+    }
+    r->tiles[r->tileCount].x = x;
+    r->tiles[r->tileCount].y = y;
+    r->tileCount++;
+}
+
+/*
+ * Add a portal index to a region's door list
+ */
+static void addRegionPortal(struct region* r, int portal){
+    r->portals = realloc(r->portals, sizeof(int) * (r->portalCount + 1));
+    if(r->portals == NULL){
+        fprintf(stderr, "ERROR: Could not grow region portal list! Aborting!\n");
+        exit(1);
+    }
+    r->portals[r->portalCount++] = portal;
+}
+
+/*
+ * Label a run of corridor starting at (x,y) with region id, adding the
+ * corridor and the walls around it to the region
+ */
+static void fillCorridor(struct floor* maze, int id, int x, int y){
+    struct position* stack;
+    int top = 0, x1, y1;
+
+    stack = malloc(sizeof(struct position) * maze->floorWidth * maze->floorHeight);
+    if(stack == NULL){
+        fprintf(stderr, "ERROR: Could not allocate corridor fill stack! Aborting!\n");
+        exit(1);
+    }
+    maze->regionMap[x][y] = id;
+    stack[top].x = x;
+    stack[top].y = y;
+    top++;
+    while(top > 0){
+        struct position p = stack[--top];
+        // Corridor tile plus the walls surrounding it
+        for(y1 = p.y - 1; y1 <= p.y + 1; y1++){
+            for(x1 = p.x - 1; x1 <= p.x + 1; x1++){
+                if(x1 < 0 || y1 < 0 || x1 >= maze->floorWidth || y1 >= maze->floorHeight){
+                    continue;
+                }
+                if(maze->floorData[x1][y1] == '#' || (x1 == p.x && y1 == p.y)){
+                    addRegionTile(&maze->regions[id], x1, y1);
+                }
+                // Corridors only join along the four directions
+                if((x1 == p.x) != (y1 == p.y) && maze->floorData[x1][y1] == '+'
+                        && maze->regionMap[x1][y1] == -1){
+                    maze->regionMap[x1][y1] = id;
+                    stack[top].x = x1;
+                    stack[top].y = y1;
+                    top++;
+                }
+            }
+        }
+    }
+    free(stack);
+}
+
+/*
+ * Cast rays across the floor plan from every open tile of each region and
+ * flag the chunk columns they pass through before hitting a wall.  Doors are
+ * treated as open since they can be opened later.
+ */
+static void genPVS(struct floor* maze){
+    int id, i, ray, cx, cz;
+    float step, dirX[PVSRAYS], dirY[PVSRAYS];
+
+    maze->pvsWidth = (maze->floorWidth + CHUNKSIZE - 1) / CHUNKSIZE;
+    maze->pvsHeight = (maze->floorHeight + CHUNKSIZE - 1) / CHUNKSIZE;
+    for(ray = 0; ray < PVSRAYS; ray++){
+        dirX[ray] = cos(ray * 2.0 * M_PI / PVSRAYS);
+        dirY[ray] = sin(ray * 2.0 * M_PI / PVSRAYS);
+    }
+
+    for(id = 0; id < maze->regionCount; id++){
+        struct region* r = &maze->regions[id];
+        r->pvs = calloc(maze->pvsWidth * maze->pvsHeight, sizeof(bool));
+        if(r->pvs == NULL){
+            fprintf(stderr, "ERROR: Could not allocate region PVS! Aborting!\n");
+            exit(1);
+        }
+        for(i = 0; i < r->tileCount; i++){
+            int sx = r->tiles[i].x;
+            int sy = r->tiles[i].y;
+            // Walls are flagged through the rays which stop on them
+            if(maze->floorData[sx][sy] == '#'){
+                continue;
+            }
+            r->pvs[(sx / CHUNKSIZE) * maze->pvsHeight + sy / CHUNKSIZE] = true;
+            for(ray = 0; ray < PVSRAYS; ray++){
+                // Half tile steps from the centre of the tile
+                for(step = 0.5; ; step += 0.5){
+                    int tx = (int)(sx + 0.5 + dirX[ray] * step);
+                    int ty = (int)(sy + 0.5 + dirY[ray] * step);
+                    if(tx < 0 || ty < 0 || tx >= maze->floorWidth || ty >= maze->floorHeight){
+                        break;
+                    }
+                    cx = tx / CHUNKSIZE;
+                    cz = ty / CHUNKSIZE;
+                    r->pvs[cx * maze->pvsHeight + cz] = true;
+                    if(maze->floorData[tx][ty] == '#'){
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    return;
+}
+
+void genPortals(struct floor* maze){
+    int x, y, i, rx, ry;
+    int dx[4] = {1, -1, 0, 0};
+    int dy[4] = {0, 0, 1, -1};
+
+    // Start with every tile unassigned
+    maze->regionMap = (int**)malloc(maze->floorWidth * sizeof(int*));
+    if(maze->regionMap == NULL){
+        fprintf(stderr, "ERROR: Could not allocate region map! Aborting!\n");
+        exit(1);
+    }
+    for(x = 0; x < maze->floorWidth; x++){
+        maze->regionMap[x] = (int*)malloc(maze->floorHeight * sizeof(int));
+        if(maze->regionMap[x] == NULL){
+            fprintf(stderr, "ERROR: Could not allocate region map column %d! Aborting!\n", x);
+            exit(1);
+        }
+        for(y = 0; y < maze->floorHeight; y++){
+            maze->regionMap[x][y] = -1;
+        }
+    }
+
+    // The nine rooms are the first regions, including their walls
+    maze->regionCount = 9;
+    maze->regions = calloc(maze->regionCount, sizeof(struct region));
+    for(ry = 0; ry < 3; ry++){
+        for(rx = 0; rx < 3; rx++){
+            struct room r = maze->rooms[rx][ry];
+            int id = ry * 3 + rx;
+            for(x = r.origin.x; x <= r.corner.x; x++){
+                for(y = r.origin.y; y <= r.corner.y; y++){
+                    addRegionTile(&maze->regions[id], x, y);
+                    if(maze->floorData[x][y] != '/' && maze->floorData[x][y] != '|'){
+                        maze->regionMap[x][y] = id;
+                    }
+                }
+            }
+        }
+    }
+
+    // Every connected run of corridor is another region
+    for(x = 0; x < maze->floorWidth; x++){
+        for(y = 0; y < maze->floorHeight; y++){
+            if(maze->floorData[x][y] == '+' && maze->regionMap[x][y] == -1){
+                maze->regions = realloc(maze->regions, sizeof(struct region) * (maze->regionCount + 1));
+                memset(&maze->regions[maze->regionCount], 0, sizeof(struct region));
+                fillCorridor(maze, maze->regionCount, x, y);
+                maze->regionCount++;
+            }
+        }
+    }
+
+    // Doors join the two different regions on either side of them
+    for(x = 1; x < maze->floorWidth - 1; x++){
+        for(y = 1; y < maze->floorHeight - 1; y++){
+            int a = -1, b = -1;
+            if(maze->floorData[x][y] != '/' && maze->floorData[x][y] != '|'){
+                continue;
+            }
+            for(i = 0; i < 4; i++){
+                int r = maze->regionMap[x + dx[i]][y + dy[i]];
+                if(r == -1 || r == a){
+                    continue;
+                }
+                if(a == -1){
+                    a = r;
+                } else {
+                    b = r;
+                }
+            }
+            if(a == -1 || b == -1){
+                continue;
+            }
+            maze->portals = realloc(maze->portals, sizeof(struct portal) * (maze->portalCount + 1));
+            maze->portals[maze->portalCount].door.x = x;
+            maze->portals[maze->portalCount].door.y = y;
+            maze->portals[maze->portalCount].regionA = a;
+            maze->portals[maze->portalCount].regionB = b;
+            addRegionPortal(&maze->regions[a], maze->portalCount);
+            addRegionPortal(&maze->regions[b], maze->portalCount);
+            // The door itself is drawn with both regions
+            addRegionTile(&maze->regions[a], x, y);
+            addRegionTile(&maze->regions[b], x, y);
+            maze->portalCount++;
+        }
+    }
+
+    // Work out what each region can see
+    genPVS(maze);
+
+    if(DEBUG==0)
+        printf("Portal graph has %d regions and %d doors...\n", maze->regionCount, maze->portalCount);
+    return;
+}
+
+void freePortals(struct floor* maze){
+    int i;
+    for(i = 0; i < maze->regionCount; i++){
+        free(maze->regions[i].tiles);
+        free(maze->regions[i].portals);
+        free(maze->regions[i].pvs);
+    }
+    free(maze->regions);
+    free(maze->portals);
+    if(maze->regionMap != NULL){
+        for(i = 0; i < maze->floorWidth; i++){
+            free(maze->regionMap[i]);
+        }
+        free(maze->regionMap);
+    }
+    maze->regionCount = 0;
+    maze->regions = NULL;
+    maze->portalCount = 0;
+    maze->portals = NULL;
+    maze->regionMap = NULL;
+    return;
+}
+
+void setPortalFloor(struct floor* maze, int baseHeight){
+    int x, y;
+
+    portalFloor = NULL;
+    if(maze == NULL || maze->regionCount == 0){
+        return;
+    }
+    portalFloor = maze;
+    portalBase = baseHeight;
+    // Tallest wall on the floor
+    portalTop = 0;
+    for(y = 0; y < 3; y++){
+        for(x = 0; x < 3; x++){
+            if(maze->rooms[x][y].ceilHeight + 1 > portalTop){
+                portalTop = maze->rooms[x][y].ceilHeight + 1;
+            }
+        }
+    }
+    return;
+}
+
+/*
+ * Flag the columns and chunk columns of a region as visible, limited to
+ * the chunk columns in the PVS of the player's region
+ */
+static void markRegion(struct region* r, bool* pvs){
+    int i;
+    for(i = 0; i < r->tileCount; i++){
+        int x = r->tiles[i].x;
+        int z = r->tiles[i].y;
+        if(x < 0 || z < 0 || x >= WORLDX || z >= WORLDZ){
+            continue;
+        }
+        if(!pvs[(x / CHUNKSIZE) * CHUNKZ + z / CHUNKSIZE]){
+            continue;
+        }
+        columnVisible[x * WORLDZ + z] = 1;
+        chunkVisible[(x / CHUNKSIZE) * CHUNKZ + z / CHUNKSIZE] = 1;
+    }
+}
+
+int portalCull(float x, float y, float z){
+    static int* queue = NULL;
+    static bool* seen = NULL;
+    static int size = 0;
+    struct floor* f = portalFloor;
+    int tx = (int)x, tz = (int)z;
+    int head = 0, tail = 0, i, cx, cz;
+
+    if(f == NULL){
+        return 0;
+    }
+    if(columnVisible == NULL){
+        columnVisible = malloc(WORLDX * WORLDZ);
+        chunkVisible = malloc(CHUNKX * CHUNKZ);
+        pvsList = malloc(sizeof(int) * 2 * CHUNKX * CHUNKZ);
+        pvsColumns = malloc(sizeof(bool) * CHUNKX * CHUNKZ);
+        if(columnVisible == NULL || chunkVisible == NULL || pvsList == NULL
+                || pvsColumns == NULL){
+            fprintf(stderr, "ERROR: Could not allocate the visible columns! Aborting!\n");
+            exit(1);
+        }
+    }
+    // Only cull when standing inside the dungeon
+    if(x < 0 || z < 0 || tx >= f->floorWidth || tz >= f->floorHeight
+            || y < portalBase || y > portalBase + portalTop + 1){
+        return 0;
+    }
+    if(size < f->regionCount){
+        size = f->regionCount;
+        queue = realloc(queue, sizeof(int) * size);
+        seen = realloc(seen, sizeof(bool) * size);
+    }
+    memset(seen, 0, sizeof(bool) * f->regionCount);
+
+    // Start from the region the player is in, a door tile starts in both rooms it joins
+    if(f->regionMap[tx][tz] != -1){
+        queue[tail++] = f->regionMap[tx][tz];
+    } else {
+        for(i = 0; i < f->portalCount; i++){
+            if(f->portals[i].door.x == tx && f->portals[i].door.y == tz){
+                queue[tail++] = f->portals[i].regionA;
+                queue[tail++] = f->portals[i].regionB;
+                break;
+            }
+        }
+    }
+    if(tail == 0){
+        return 0;
+    }
+    // Combined PVS of the starting regions, culling only looks at these chunk columns
+    memset(pvsColumns, 0, sizeof(bool) * CHUNKX * CHUNKZ);
+    pvsCount = 0;
+    for(cx = 0; cx < f->pvsWidth && cx < CHUNKX; cx++){
+        for(cz = 0; cz < f->pvsHeight && cz < CHUNKZ; cz++){
+            for(i = 0; i < tail; i++){
+                if(f->regions[queue[i]].pvs[cx * f->pvsHeight + cz]){
+                    pvsColumns[cx * CHUNKZ + cz] = true;
+                    pvsList[pvsCount][0] = cx;
+                    pvsList[pvsCount][1] = cz;
+                    pvsCount++;
+                    break;
+                }
+            }
+        }
+    }
+    for(i = 0; i < tail; i++){
+        seen[queue[i]] = true;
+    }
+
+    memset(columnVisible, 0, WORLDX * WORLDZ);
+    memset(chunkVisible, 0, CHUNKX * CHUNKZ);
+    // Walk through open doors which are on screen
+    while(head < tail){
+        struct region* r = &f->regions[queue[head++]];
+        markRegion(r, pvsColumns);
+        for(i = 0; i < r->portalCount; i++){
+            struct portal* p = &f->portals[r->portals[i]];
+            int next = seen[p->regionA] ? p->regionB : p->regionA;
+            if(seen[next] || f->floorData[p->door.x][p->door.y] != '|'){
+                continue;
+            }
+            // Door opening is the two cubes above the floor tile
+            if(CubeInFrustum(p->door.x + 0.5, portalBase + 2.0, p->door.y + 0.5, 1.0)){
+                seen[next] = true;
+                queue[tail++] = next;
+            }
+        }
+    }
+    return 1;
+}
+
+int portalColumnVisible(int x, int z){
+    return columnVisible[x * WORLDZ + z];
+}
+
+int portalChunkVisible(int x, int z){
+    return chunkVisible[x * CHUNKZ + z];
+}
+
+int portalChunkList(int list[][2]){
+    memcpy(list, pvsList, sizeof(int) * 2 * pvsCount);
+    return pvsCount;
+}
@@ -0,0 +1,47 @@
+/*
+ * Portal culling for DUNGEON floors.
+ * Rooms and runs of corridor are regions joined by doors (portals).  Each
+ * frame the regions which can be seen from the player's region through open,
+ * on screen doors are found and only their columns of the world are drawn.
+ * Needs maze.h
+ */
+
+/*
+ * Build the region/portal graph for a generated dungeon floor, along with
+ * the potentially visible set (PVS) of chunk columns for each region
+ */
+void genPortals(struct floor* maze);
+
+/*
+ * Free the region/portal graph of a floor
+ */
+void freePortals(struct floor* maze);
+
+/*
+ * Select the floor to cull with, NULL (or a floor without a portal graph)
+ * turns portal culling off.  baseHeight is the world y of the floor tiles.
+ */
+void setPortalFloor(struct floor* maze, int baseHeight);
+
+/*
+ * Find the visible regions for a viewpoint at world position (x,y,z).
+ * The frustum must already be extracted.  Returns 1 if culling applies,
+ * 0 if everything should be drawn (not a dungeon, or outside the rooms).
+ */
+int portalCull(float x, float y, float z);
+
+/*
+ * After portalCull(), returns 1 if world column (x,z) may be seen
+ */
+int portalColumnVisible(int x, int z);
+
+/*
+ * After portalCull(), returns 1 if any column of chunk column (x,z) may be seen
+ */
+int portalChunkVisible(int x, int z);
+
+/*
+ * After portalCull(), copies the chunk columns in the PVS of the player's
+ * region into list and returns how many there are
+ */
+int portalChunkList(int list[][2]);
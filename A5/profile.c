@@ -0,0 +1,204 @@
+/* Per phase frame profiler */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "graphics.h"
+#include "profile.h"
+#include "timer.h"
+
+extern void draw2Dline(int, int, int, int, int);
+extern void draw2Dbox(int, int, int, int);
+extern void set2Dcolour(float []);
+extern void begin2Dpanel(int, int, int, int);
+extern void end2Dpanel();
+
+extern int screenWidth, screenHeight;
+extern int showProfile;
+extern char *profileFile;
+
+// Column names for the CSV, same order as enum profilePhase
+static const char *phaseNames[PROF_PHASES] = {
+   "frame", "gravity", "collision", "arrow", "clouds", "turn", "mobs",
+   "items", "cull", "cubes", "meshes", "2d", "terrain"
+};
+
+// Bar colour of each phase in the overlay
+static GLfloat phaseColours[PROF_PHASES][4] = {
+   {0.9, 0.9, 0.9, 0.75},
+   {0.4, 0.4, 1.0, 0.75},
+   {0.0, 0.6, 1.0, 0.75},
+   {0.0, 0.8, 0.8, 0.75},
+   {0.8, 0.8, 1.0, 0.75},
+   {0.5, 0.1, 1.0, 0.75},
+   {1.0, 0.4, 0.8, 0.75},
+   {1.0, 0.85, 0.0, 0.75},
+   {1.0, 0.5, 0.0, 0.75},
+   {0.0, 0.8, 0.0, 0.75},
+   {0.6, 0.4, 0.2, 0.75},
+   {1.0, 0.2, 0.2, 0.75},
+   {0.4, 0.7, 0.3, 0.75}
+};
+
+// Start of each phase that is running
+static double started[PROF_PHASES];
+// Time spent in each phase so far this frame
+static double current[PROF_PHASES];
+// Per frame totals over the window, frameCount % PROFWINDOW is the next slot
+static double history[PROF_PHASES][PROFWINDOW];
+static int frameCount = 0;
+// End of the last frame, 0 when the profiler was off for it
+static double lastFrame = 0.0;
+
+static FILE *csv = NULL;
+
+/*
+ * Anything to time for
+ */
+static int profiling(){
+   return (showProfile == 1) || (profileFile != NULL);
+}
+
+/*
+ * Frames in the window which have been filled
+ */
+static int windowSize(){
+   return (frameCount < PROFWINDOW) ? frameCount : PROFWINDOW;
+}
+
+/*
+ * Append the window's statistics to the -profile CSV
+ */
+static void writeRow(){
+   int i;
+
+   if(csv == NULL){
+      csv = fopen(profileFile, "w");
+      if(csv == NULL){
+         fprintf(stderr, "ERROR: Could not open %s to write the profile! Aborting!\n", profileFile);
+         exit(1);
+      }
+      fprintf(csv, "frame");
+      for(i = 0; i < PROF_PHASES; i++){
+         fprintf(csv, ",%s_avg_ms,%s_p50_ms,%s_p99_ms",
+            phaseNames[i], phaseNames[i], phaseNames[i]);
+      }
+      fprintf(csv, "\n");
+   }
+   fprintf(csv, "%d", frameCount);
+   for(i = 0; i < PROF_PHASES; i++){
+      fprintf(csv, ",%.3f,%.3f,%.3f", profileAverage(i),
+         profilePercentile(i, 50.0), profilePercentile(i, 99.0));
+   }
+   fprintf(csv, "\n");
+   fflush(csv);
+}
+
+void profileBegin(int phase){
+   if(!profiling()){
+      return;
+   }
+   started[phase] = timerMillis();
+}
+
+void profileEnd(int phase){
+   if(!profiling()){
+      return;
+   }
+   current[phase] += timerMillis() - started[phase];
+}
+
+void profileFrame(){
+   double t;
+   int i;
+
+   if(!profiling()){
+      lastFrame = 0.0;
+      return;
+   }
+   t = timerMillis();
+   // Only part of the first frame after turning on was timed, drop it
+   if(lastFrame == 0.0){
+      lastFrame = t;
+      for(i = 0; i < PROF_PHASES; i++){
+         current[i] = 0.0;
+      }
+      return;
+   }
+   current[PROF_FRAME] = t - lastFrame;
+   lastFrame = t;
+
+   for(i = 0; i < PROF_PHASES; i++){
+      history[i][frameCount % PROFWINDOW] = current[i];
+      current[i] = 0.0;
+   }
+   frameCount++;
+   if(profileFile != NULL && frameCount % PROFWINDOW == 0){
+      writeRow();
+   }
+}
+
+double profileAverage(int phase){
+   double total = 0.0;
+   int i, count = windowSize();
+
+   if(count == 0){
+      return 0.0;
+   }
+   for(i = 0; i < count; i++){
+      total += history[phase][i];
+   }
+   return total / count;
+}
+
+double profilePercentile(int phase, double percentile){
+   double sorted[PROFWINDOW];
+   int index, count = windowSize();
+
+   if(count == 0){
+      return 0.0;
+   }
+   memcpy(sorted, history[phase], sizeof(double) * count);
+   qsort(sorted, count, sizeof(double), compareTimes);
+   // Nearest rank
+   index = (int)ceil(percentile / 100.0 * count) - 1;
+   if(index < 0) index = 0;
+   if(index >= count) index = count - 1;
+   return sorted[index];
+}
+
+void profileDraw(){
+   GLfloat white[] = {1.0, 1.0, 1.0, 1.0};
+   // Bars are drawn along the top left, the budget is budgetWidth wide
+   // and bars stop at twice the budget
+   int left = 10, top = screenHeight - 10;
+   int rowHeight = 12, budgetWidth = 300;
+   int i, y, width;
+
+   if(showProfile == 0){
+      return;
+   }
+   begin2Dpanel(left - 4, top - PROF_PHASES * rowHeight - 4,
+      left + 2 * budgetWidth + 4, top + 4);
+
+   for(i = 0; i < PROF_PHASES; i++){
+      y = top - (i + 1) * rowHeight;
+      width = (int)(profileAverage(i) / PROFBUDGET * budgetWidth);
+      if(width > 2 * budgetWidth) width = 2 * budgetWidth;
+      set2Dcolour(phaseColours[i]);
+      draw2Dbox(left, y + 2, left + width, y + rowHeight - 2);
+
+      // Tick at the 99th percentile
+      width = (int)(profilePercentile(i, 99.0) / PROFBUDGET * budgetWidth);
+      if(width > 2 * budgetWidth) width = 2 * budgetWidth;
+      set2Dcolour(white);
+      draw2Dline(left + width, y + 1, left + width, y + rowHeight - 1, 2);
+   }
+
+   // Frame budget
+   draw2Dline(left + budgetWidth, top - PROF_PHASES * rowHeight - 4,
+      left + budgetWidth, top + 4, 1);
+   end2Dpanel();
+}
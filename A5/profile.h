@@ -0,0 +1,60 @@
+/*
+ * Per phase frame profiler.
+ * Each phase of update() and display() is wrapped in profileBegin() and
+ * profileEnd(), the time spent in a phase is added up over a frame and
+ * display() hands the totals over with profileFrame().  Averages and
+ * percentiles are taken over the last PROFWINDOW frames.
+ * Times are wall-clock time measured on the calling thread, OpenGL may
+ * still be drawing after a phase ends.
+ * Timing only happens while the overlay is shown ('p') or -profile file
+ * is writing the CSV, otherwise the calls return straight away.
+ */
+
+	/* frames the averages and percentiles are taken over */
+#define PROFWINDOW 120
+	/* frame time the overlay is scaled against (60 fps) */
+#define PROFBUDGET 16.7
+
+	/* timed phases, in the order they are drawn in the overlay */
+enum profilePhase {
+   PROF_FRAME,		// whole frame, from one profileFrame() to the next
+   PROF_GRAVITY,
+   PROF_COLLISION,
+   PROF_ARROW,
+   PROF_CLOUDS,
+   PROF_TURN,		// turnCheck() and the dungeon map's updateVisible()
+   PROF_MOBS,
+   PROF_ITEMS,
+   PROF_CULL,		// buildDisplayList() and chunk remeshing
+   PROF_CUBES,
+   PROF_MESHES,		// mobs, meshes, players and tubes
+   PROF_2D,
+   PROF_TERRAIN,	// streamTerrain(), sliding the outdoor world
+   PROF_PHASES
+};
+
+/*
+ * Start and stop timing phase
+ */
+void profileBegin(int phase);
+void profileEnd(int phase);
+
+/*
+ * End the frame, called once at the end of display().  Every PROFWINDOW
+ * frames a row is written to the -profile CSV.
+ */
+void profileFrame();
+
+/*
+ * Average and percentile (0 to 100) of a phase over the window, in
+ * milliseconds
+ */
+double profileAverage(int phase);
+double profilePercentile(int phase, double percentile);
+
+/*
+ * Draw the overlay with the draw2D primitives, one bar for each phase
+ * showing its average with a tick at the 99th percentile.  Called from
+ * the 2D section of display().
+ */
+void profileDraw();
@@ -0,0 +1,186 @@
+/* GLSL 1.20 shaders for drawing the chunk meshes */
+/* Lighting follows the fixed function equations using the gl_LightSource[] */
+/* state set in init() and display(), so both paths look the same */
+
+	/* shader functions are GL 2.0, ask for their prototypes */
+#define GL_GLEXT_PROTOTYPES
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "graphics.h"
+#include "shader.h"
+
+	/* colour and texture information from graphics.c */
+extern int getObjectColour(int, GLfloat [4], GLfloat [4]);
+extern int textureAssigned[NUMBERCOLOURS];
+extern float tOffset[NUMBERCOLOURS][2];
+extern void setObjectAtlas();
+extern float atlasRegion[NUMBERTEXTURES][4];
+
+	/* program and uniform/attribute locations */
+static GLuint program = 0;
+static GLint ambientLoc, diffuseLoc, tileLoc, offsetLoc, atlasLoc;
+static GLint colourLoc;
+
+	/* per vertex lighting, material looked up by colour id */
+static const char *vertexSource =
+"uniform vec4 ambient[NUMBERCOLOURS];\n"
+"uniform vec4 diffuse[NUMBERCOLOURS];\n"
+"attribute float colourId;\n"
+"varying vec4 colour;\n"
+"varying vec2 texCoord;\n"
+"varying float id;\n"
+"\n"
+"vec4 light(int i, vec3 pos, vec3 n, vec4 amb, vec4 dif) {\n"
+"   vec4 lp = gl_LightSource[i].position;\n"
+"   vec3 l;\n"
+"   float att = 1.0;\n"
+"   if (lp.w == 0.0) {\n"
+"      l = normalize(lp.xyz);\n"
+"   } else {\n"
+"      vec3 d = lp.xyz / lp.w - pos;\n"
+"      float dist = length(d);\n"
+"      l = d / dist;\n"
+"      att = 1.0 / (gl_LightSource[i].constantAttenuation\n"
+"         + gl_LightSource[i].linearAttenuation * dist\n"
+"         + gl_LightSource[i].quadraticAttenuation * dist * dist);\n"
+"   }\n"
+"   return att * (gl_LightSource[i].ambient * amb\n"
+"      + max(dot(n, l), 0.0) * gl_LightSource[i].diffuse * dif);\n"
+"}\n"
+"\n"
+"void main() {\n"
+"   int c = int(colourId + 0.5);\n"
+"   vec3 pos = (gl_ModelViewMatrix * gl_Vertex).xyz;\n"
+"   vec3 n = normalize(gl_NormalMatrix * gl_Normal);\n"
+"   colour = gl_LightModel.ambient * ambient[c]\n"
+"      + light(0, pos, n, ambient[c], diffuse[c])\n"
+"      + light(1, pos, n, ambient[c], diffuse[c]);\n"
+"   colour = clamp(colour, 0.0, 1.0);\n"
+"   colour.a = diffuse[c].a;\n"
+"   texCoord = gl_MultiTexCoord0.xy;\n"
+"   id = colourId;\n"
+"   gl_Position = ftransform();\n"
+"}\n";
+
+	/* textures repeat inside their area of the atlas */
+static const char *fragmentSource =
+"uniform sampler2D atlas;\n"
+"uniform vec4 tile[NUMBERCOLOURS];\n"
+"uniform vec2 offset[NUMBERCOLOURS];\n"
+"varying vec4 colour;\n"
+"varying vec2 texCoord;\n"
+"varying float id;\n"
+"\n"
+"void main() {\n"
+"   int c = int(id + 0.5);\n"
+"   vec4 result = colour;\n"
+"   if (tile[c].z > 0.0) {\n"
+"      vec2 uv = fract(texCoord + offset[c]);\n"
+"      result *= texture2D(atlas, tile[c].xy + uv * tile[c].zw);\n"
+"   }\n"
+"   gl_FragColor = result;\n"
+"}\n";
+
+/*
+ * Compile one shader, prints the log and returns 0 on failure
+ */
+static GLuint compileShader(GLenum type, const char *source){
+   char header[64];
+   const char *sources[2];
+   GLuint shader;
+   GLint status;
+
+   // Version and table sizes go in front of the shader body
+   sprintf(header, "#version 120\n#define NUMBERCOLOURS %d\n", NUMBERCOLOURS);
+   sources[0] = header;
+   sources[1] = source;
+   shader = glCreateShader(type);
+   glShaderSource(shader, 2, sources, NULL);
+   glCompileShader(shader);
+   glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+   if(status != GL_TRUE){
+      char log[1024];
+      glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+      printf("Shader compile failed:\n%s\n", log);
+      glDeleteShader(shader);
+      return 0;
+   }
+   return shader;
+}
+
+int initShader(){
+   const char *version = (const char *) glGetString(GL_VERSION);
+   GLuint vertex, fragment;
+   GLint status;
+
+   if(version == NULL || atoi(version) < 2){
+      printf("OpenGL 2.0 is needed for shaders, found %s.\n", (version == NULL) ? "none" : version);
+      return 1;
+   }
+
+   vertex = compileShader(GL_VERTEX_SHADER, vertexSource);
+   fragment = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+   if(vertex == 0 || fragment == 0){
+      return 1;
+   }
+   program = glCreateProgram();
+   glAttachShader(program, vertex);
+   glAttachShader(program, fragment);
+   glLinkProgram(program);
+   glDeleteShader(vertex);
+   glDeleteShader(fragment);
+   glGetProgramiv(program, GL_LINK_STATUS, &status);
+   if(status != GL_TRUE){
+      char log[1024];
+      glGetProgramInfoLog(program, sizeof(log), NULL, log);
+      printf("Shader link failed:\n%s\n", log);
+      glDeleteProgram(program);
+      program = 0;
+      return 1;
+   }
+
+   ambientLoc = glGetUniformLocation(program, "ambient");
+   diffuseLoc = glGetUniformLocation(program, "diffuse");
+   tileLoc = glGetUniformLocation(program, "tile");
+   offsetLoc = glGetUniformLocation(program, "offset");
+   atlasLoc = glGetUniformLocation(program, "atlas");
+   colourLoc = glGetAttribLocation(program, "colourId");
+   return 0;
+}
+
+void beginShader(){
+   static GLfloat ambient[NUMBERCOLOURS][4], diffuse[NUMBERCOLOURS][4];
+   static GLfloat tile[NUMBERCOLOURS][4];
+   int c;
+
+   // Colours and textures can be changed at any time so refresh the tables
+   for(c = 0; c < NUMBERCOLOURS; c++){
+      getObjectColour(c, ambient[c], diffuse[c]);
+      if(textureAssigned[c] != -1){
+         memcpy(tile[c], atlasRegion[textureAssigned[c]], sizeof(GLfloat) * 4);
+      } else {
+         memset(tile[c], 0, sizeof(GLfloat) * 4);
+      }
+   }
+
+   glUseProgram(program);
+   glUniform4fv(ambientLoc, NUMBERCOLOURS, &(ambient[0][0]));
+   glUniform4fv(diffuseLoc, NUMBERCOLOURS, &(diffuse[0][0]));
+   glUniform4fv(tileLoc, NUMBERCOLOURS, &(tile[0][0]));
+   glUniform2fv(offsetLoc, NUMBERCOLOURS, &(tOffset[0][0]));
+   glUniform1i(atlasLoc, 0);
+   setObjectAtlas();
+   glEnableVertexAttribArray(colourLoc);
+}
+
+void endShader(){
+   glDisableVertexAttribArray(colourLoc);
+   glUseProgram(0);
+}
+
+void shaderColourPointer(GLsizei stride, const GLvoid *pointer){
+   glVertexAttribPointer(colourLoc, 1, GL_FLOAT, GL_FALSE, stride, pointer);
+}
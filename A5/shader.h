@@ -0,0 +1,29 @@
+/*
+ * Optional GLSL render path for the chunk meshes (-shader).
+ * Materials, texture atlas areas and texture offsets for every colour id are
+ * stored in uniform tables so a whole chunk, whatever colours it contains,
+ * is drawn with a single call and no material or texture changes.
+ */
+
+/*
+ * Compile and link the chunk shaders.
+ * Returns 0 on success, 1 if shaders are not available (the caller should
+ * fall back to fixed function drawing).
+ */
+int initShader();
+
+/*
+ * Make the chunk shader current and upload the colour tables, call once
+ * before drawing the chunks each frame
+ */
+void beginShader();
+
+/*
+ * Return to fixed function drawing
+ */
+void endShader();
+
+/*
+ * Point the per vertex colour id attribute at a vertex array
+ */
+void shaderColourPointer(GLsizei stride, const GLvoid *pointer);
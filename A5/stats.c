@@ -0,0 +1,133 @@
+/* Render statistics counters */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "graphics.h"
+#include "world.h"
+#include "stats.h"
+
+extern void draw2Dline(int, int, int, int, int);
+extern void draw2Dbox(int, int, int, int);
+extern void set2Dcolour(float []);
+extern void begin2Dpanel(int, int, int, int);
+extern void end2Dpanel();
+
+extern int screenWidth, screenHeight;
+extern int showStats;
+
+struct renderStats frameStats;
+static struct renderStats lastStats;
+
+// Digit size in the overlay, in pixels
+#define DIGITWIDTH 6
+#define DIGITHEIGHT 10
+
+// Seven segment patterns for 0 to 9, bit 0 is the top segment and the
+// rest go clockwise with the middle segment last
+static const unsigned char segments[10] = {
+   0x3f, 0x06, 0x5b, 0x4f, 0x66, 0x6d, 0x7d, 0x07, 0x7f, 0x6f
+};
+
+void statsFrame(){
+   lastStats = frameStats;
+   memset(&frameStats, 0, sizeof(frameStats));
+}
+
+const struct renderStats *getRenderStats(){
+   return &lastStats;
+}
+
+void statsAddCulling(struct renderStats *stats){
+   int i;
+
+   for(i = 0; i < OCCUPANCYLEVELS; i++){
+      frameStats.nodesVisited[i] += stats->nodesVisited[i];
+      frameStats.nodesCulled[i] += stats->nodesCulled[i];
+      stats->nodesVisited[i] = 0;
+      stats->nodesCulled[i] = 0;
+   }
+   frameStats.cubesTested += stats->cubesTested;
+   frameStats.cubesCulled += stats->cubesCulled;
+   stats->cubesTested = 0;
+   stats->cubesCulled = 0;
+}
+
+/*
+ * Draw value with its lower left corner at (x, y), returns the x after it
+ */
+static int drawNumber(int x, int y, int value){
+   char digits[16];
+   int i, s;
+
+   snprintf(digits, sizeof(digits), "%d", value);
+   for(i = 0; digits[i] != '\0'; i++){
+      int w = DIGITWIDTH, h = DIGITHEIGHT, m = DIGITHEIGHT / 2;
+      if(digits[i] < '0' || digits[i] > '9'){
+         continue;
+      }
+      s = segments[digits[i] - '0'];
+      if(s & 0x01) draw2Dline(x, y + h, x + w, y + h, 2);
+      if(s & 0x02) draw2Dline(x + w, y + h, x + w, y + m, 2);
+      if(s & 0x04) draw2Dline(x + w, y + m, x + w, y, 2);
+      if(s & 0x08) draw2Dline(x, y, x + w, y, 2);
+      if(s & 0x10) draw2Dline(x, y, x, y + m, 2);
+      if(s & 0x20) draw2Dline(x, y + m, x, y + h, 2);
+      if(s & 0x40) draw2Dline(x, y + m, x + w, y + m, 2);
+      x += w + 4;
+   }
+   return x;
+}
+
+void statsDraw(){
+   GLfloat white[] = {1.0, 1.0, 1.0, 1.0};
+   GLfloat grey[] = {0.6, 0.6, 0.6, 1.0};
+   // Swatch colour of each row
+   GLfloat colours[][4] = {
+      {0.0, 0.8, 0.0, 1.0},	// cubes, chunks
+      {0.4, 0.4, 1.0, 1.0},	// faces
+      {1.0, 0.5, 0.0, 1.0},	// draw calls
+      {1.0, 0.85, 0.0, 1.0},	// material and texture changes
+      {1.0, 0.4, 0.8, 1.0},	// meshes
+      {0.0, 0.8, 0.8, 1.0},	// cubes tested and culled
+      {0.5, 0.1, 1.0, 1.0}	// nodes visited and culled, level 0 up
+   };
+   const struct renderStats *s = &lastStats;
+   // Rows are drawn down the top right, two numbers to a row
+   int rowHeight = DIGITHEIGHT + 6;
+   // Only the octree levels this world has get a row
+   int rows = 6 + occupancyLevels;
+   int left = screenWidth - 200, top = screenHeight - 10;
+   int first[6 + OCCUPANCYLEVELS], second[6 + OCCUPANCYLEVELS];
+   int colour[6 + OCCUPANCYLEVELS];
+   int i, x, y;
+
+   if(showStats == 0){
+      return;
+   }
+   first[0] = s->cubes;           second[0] = s->chunks;          colour[0] = 0;
+   first[1] = s->faces;           second[1] = -1;                 colour[1] = 1;
+   first[2] = s->drawCalls;       second[2] = -1;                 colour[2] = 2;
+   first[3] = s->materialChanges; second[3] = s->textureChanges;  colour[3] = 3;
+   first[4] = s->meshes;          second[4] = -1;                 colour[4] = 4;
+   first[5] = s->cubesTested;     second[5] = s->cubesCulled;     colour[5] = 5;
+   for(i = 0; i < OCCUPANCYLEVELS; i++){
+      first[6 + i] = s->nodesVisited[i];
+      second[6 + i] = s->nodesCulled[i];
+      colour[6 + i] = 6;
+   }
+
+   begin2Dpanel(left - 4, top - rows * rowHeight - 4, screenWidth - 6, top + 4);
+   for(i = 0; i < rows; i++){
+      y = top - (i + 1) * rowHeight + 3;
+      set2Dcolour(colours[colour[i]]);
+      draw2Dbox(left, y, left + 10, y + DIGITHEIGHT);
+      set2Dcolour(white);
+      x = drawNumber(left + 18, y, first[i]);
+      if(second[i] >= 0){
+         set2Dcolour(grey);
+         drawNumber((x > left + 100) ? x + 10 : left + 100, y, second[i]);
+      }
+   }
+   end2Dpanel();
+}
@@ -0,0 +1,57 @@
+/*
+ * Counts of the work done to cull and draw a frame.
+ * Culling and drawing add to frameStats as they go and display() ends the
+ * frame with statsFrame(), after which getRenderStats() returns the
+ * finished frame.  Culling is skipped on frames where the view and world
+ * have not changed, so the node counts are 0 for those frames.
+ * Include after world.h.
+ */
+
+struct renderStats {
+   // Octree nodes tested against the frustum and occlusion buffer, and
+   // those rejected, by occupancy level (0 is a brick).  Chunk and PVS
+   // culling count their chunks as nodes at the chunk level.
+   int nodesVisited[OCCUPANCYLEVELS];
+   int nodesCulled[OCCUPANCYLEVELS];
+   // Single cubes tested and rejected inside bricks (or PVS chunks)
+   int cubesTested;
+   int cubesCulled;
+   // Cubes drawn one at a time and chunk meshes drawn
+   int cubes;
+   int chunks;
+   // Cube faces drawn, a greedy chunk quad counts as one face
+   int faces;
+   // glBegin() and glDrawArrays() calls, and solid shapes, for the world,
+   // mobs, players, tubes and meshes (the 2D overlay is not counted)
+   int drawCalls;
+   // Material colour and texture binding changes sent to OpenGL
+   int materialChanges;
+   int textureChanges;
+   // Mesh instances drawn
+   int meshes;
+};
+
+	/* counts for the frame being drawn */
+extern struct renderStats frameStats;
+
+/*
+ * Finish the frame being counted, called once at the end of display()
+ */
+void statsFrame();
+
+/*
+ * Counts for the last finished frame
+ */
+const struct renderStats *getRenderStats();
+
+/*
+ * Add the culling counts in stats to frameStats and clear them, used to
+ * gather the counts each culling thread kept for itself
+ */
+void statsAddCulling(struct renderStats *stats);
+
+/*
+ * Draw the counts on screen with the draw2D primitives, called from the
+ * 2D section of display() and shown when toggled with 'i'
+ */
+void statsDraw();
@@ -0,0 +1,186 @@
+/* Streamed outdoor terrain heights */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "graphics.h"
+#include "terrain.h"
+
+	/* noise from perlin.c */
+extern float perlin2d(float x, float y, float freq, int depth);
+
+// States of a cache slot
+#define SLOT_EMPTY 0
+#define SLOT_QUEUED 1
+#define SLOT_READY 2
+
+// Heights of one chunk column, (cx,cz) in chunk units
+struct terrainSlot {
+   int cx, cz;
+   int state;
+   unsigned char height[CHUNKSIZE][CHUNKSIZE];
+};
+
+// The cache is a slotSide x slotSide grid, chunk column (cx,cz) can only
+// go in slot (cx,cz) modulo slotSide so a lookup is one compare.  The side
+// is big enough that the window and TERRAINAHEAD chunks around it never
+// share a slot, anything further away is written over.
+static struct terrainSlot *slots = NULL;
+static int slotSide;
+
+// Chunk columns waiting for the background thread, queueHead == queueTail
+// when it is empty
+static int (*queue)[2] = NULL;
+static int queueSize, queueHead = 0, queueTail = 0;
+
+// Guards the slots and the queue, the thread sleeps on terrainWake
+static pthread_mutex_t terrainLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t terrainWake = PTHREAD_COND_INITIALIZER;
+
+/*
+ * Chunk holding global column x, rounding down for negative columns
+ */
+static int chunkOf(int x){
+   return (x >= 0) ? x / CHUNKSIZE : (x + 1) / CHUNKSIZE - 1;
+}
+
+static struct terrainSlot *slotFor(int cx, int cz){
+   return &slots[(cx & (slotSide - 1)) * slotSide + (cz & (slotSide - 1))];
+}
+
+/*
+ * Work out the heights of chunk column (cx,cz), the same sum the 100x100
+ * outdoor floor used so the window at (0,0) matches it
+ */
+static void generate(int cx, int cz, unsigned char height[CHUNKSIZE][CHUNKSIZE]){
+   int x, z;
+
+   for(x = 0; x < CHUNKSIZE; x++){
+      for(z = 0; z < CHUNKSIZE; z++){
+         float h = perlin2d((float)(cx * CHUNKSIZE + x), (float)(cz * CHUNKSIZE + z),
+            TERRAINFREQ, 1);
+         height[x][z] = (unsigned char)floor(h * TERRAINHEIGHT);
+      }
+   }
+}
+
+/*
+ * Background thread, generates queued chunk columns until the queue is
+ * empty then sleeps.  The noise is worked out without the lock held, the
+ * result is dropped if the slot was given to another chunk meanwhile.
+ */
+static void *terrainMain(void *arg){
+   unsigned char height[CHUNKSIZE][CHUNKSIZE];
+   struct terrainSlot *slot;
+   int cx, cz;
+
+   (void)arg;
+   while(1){
+      pthread_mutex_lock(&terrainLock);
+      while(queueHead == queueTail){
+         pthread_cond_wait(&terrainWake, &terrainLock);
+      }
+      cx = queue[queueHead][0];
+      cz = queue[queueHead][1];
+      queueHead = (queueHead + 1) % queueSize;
+      slot = slotFor(cx, cz);
+      if(slot->cx != cx || slot->cz != cz || slot->state != SLOT_QUEUED){
+         pthread_mutex_unlock(&terrainLock);
+         continue;
+      }
+      pthread_mutex_unlock(&terrainLock);
+
+      generate(cx, cz, height);
+
+      pthread_mutex_lock(&terrainLock);
+      if(slot->cx == cx && slot->cz == cz && slot->state == SLOT_QUEUED){
+         memcpy(slot->height, height, sizeof(height));
+         slot->state = SLOT_READY;
+      }
+      pthread_mutex_unlock(&terrainLock);
+   }
+   return NULL;
+}
+
+void initTerrain(){
+   pthread_t thread;
+   int span;
+
+   if(slots != NULL){
+      return;
+   }
+   span = ((CHUNKX > CHUNKZ) ? CHUNKX : CHUNKZ) + 2 * TERRAINAHEAD;
+   for(slotSide = 1; slotSide < span; slotSide *= 2);
+   slots = calloc(slotSide * slotSide, sizeof(struct terrainSlot));
+   queueSize = slotSide * slotSide;
+   queue = calloc(queueSize, sizeof(int[2]));
+   if(slots == NULL || queue == NULL){
+      fprintf(stderr, "ERROR: Could not allocate the terrain cache! Aborting!\n");
+      exit(1);
+   }
+   // Without the thread every chunk is generated when it is first needed
+   if(pthread_create(&thread, NULL, terrainMain, NULL) != 0){
+      printf("Could not start the terrain thread, generating terrain as needed.\n");
+      return;
+   }
+   pthread_detach(thread);
+}
+
+int terrainHeight(int x, int z){
+   int cx = chunkOf(x), cz = chunkOf(z);
+   int ox = x - cx * CHUNKSIZE, oz = z - cz * CHUNKSIZE;
+   unsigned char height[CHUNKSIZE][CHUNKSIZE];
+   struct terrainSlot *slot = slotFor(cx, cz);
+   int h;
+
+   pthread_mutex_lock(&terrainLock);
+   if(slot->cx == cx && slot->cz == cz && slot->state == SLOT_READY){
+      h = slot->height[ox][oz];
+      pthread_mutex_unlock(&terrainLock);
+      return h;
+   }
+   pthread_mutex_unlock(&terrainLock);
+
+   // Not ready, make the whole chunk column now as the neighbouring
+   // columns are bound to be asked for next
+   generate(cx, cz, height);
+   pthread_mutex_lock(&terrainLock);
+   slot->cx = cx;
+   slot->cz = cz;
+   slot->state = SLOT_READY;
+   memcpy(slot->height, height, sizeof(height));
+   pthread_mutex_unlock(&terrainLock);
+   return height[ox][oz];
+}
+
+void terrainPrefetch(int x0, int z0, int x1, int z1){
+   int cx, cz, queued = 0;
+
+   pthread_mutex_lock(&terrainLock);
+   for(cx = chunkOf(x0); cx <= chunkOf(x1); cx++){
+      for(cz = chunkOf(z0); cz <= chunkOf(z1); cz++){
+         struct terrainSlot *slot = slotFor(cx, cz);
+         if(slot->cx == cx && slot->cz == cz && slot->state != SLOT_EMPTY){
+            continue;
+         }
+         // A full queue is left for terrainHeight() to catch up on
+         if((queueTail + 1) % queueSize == queueHead){
+            continue;
+         }
+         slot->cx = cx;
+         slot->cz = cz;
+         slot->state = SLOT_QUEUED;
+         queue[queueTail][0] = cx;
+         queue[queueTail][1] = cz;
+         queueTail = (queueTail + 1) % queueSize;
+         queued = 1;
+      }
+   }
+   if(queued){
+      pthread_cond_signal(&terrainWake);
+   }
+   pthread_mutex_unlock(&terrainLock);
+}
@@ -0,0 +1,39 @@
+/*
+ * Streamed outdoor terrain.
+ * The outdoor floor is a Perlin heightmap with no edges.  The world array
+ * is a WORLDX x WORLDZ window onto it which a5.c slides a chunk at a time
+ * with worldShift() as the player walks, so terrain coordinates here are
+ * global: the window's corner plus the world coordinate.
+ * Heights are generated a CHUNKSIZE x CHUNKSIZE column of chunks at a
+ * time and kept in a cache with one byte per column.  The cache only has
+ * room for the window and a few chunks around it, chunks further away are
+ * dropped and generated again from the seed if the player comes back.
+ * A background thread generates the chunks asked for by terrainPrefetch()
+ * so they are ready before the window reaches them.
+ */
+
+	/* heights run from 0 to TERRAINHEIGHT - 1 cubes above the ground */
+#define TERRAINHEIGHT 22
+	/* Perlin frequency of the heightmap */
+#define TERRAINFREQ 0.1
+	/* chunk columns past each side of the window kept in the cache */
+#define TERRAINAHEAD 2
+
+/*
+ * Size the cache for the world and start the background thread, called
+ * when the outdoor floor is built.  Safe to call again, later calls do
+ * nothing.
+ */
+void initTerrain();
+
+/*
+ * Height of the terrain at global column (x,z), taken from the cache or
+ * generated on the spot when the background thread has not got to it
+ */
+int terrainHeight(int x, int z);
+
+/*
+ * Ask the background thread to generate every chunk column holding the
+ * global columns from (x0,z0) to (x1,z1) which is not already cached
+ */
+void terrainPrefetch(int x0, int z0, int x1, int z1);
@@ -0,0 +1,18 @@
+/* Monotonic timing */
+
+#include <time.h>
+
+#include "timer.h"
+
+double timerMillis(){
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+int compareTimes(const void *a, const void *b){
+   double x = *(const double *)a, y = *(const double *)b;
+
+   return (x > y) - (x < y);
+}
@@ -0,0 +1,14 @@
+/*
+ * Monotonic timing shared by the profiler, the benchmarks and the trace.
+ */
+
+/*
+ * Wall clock time in milliseconds on a monotonic clock, only the
+ * difference between two calls means anything
+ */
+double timerMillis();
+
+/*
+ * qsort() comparison for an array of doubles, smallest first
+ */
+int compareTimes(const void *a, const void *b);
@@ -0,0 +1,83 @@
+/* Chrome trace event output */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "trace.h"
+#include "timer.h"
+
+extern char *traceFile;
+
+static FILE *trace = NULL;
+// Start of the trace, event times are counted from here
+static double startTime;
+// A frame span is open
+static int inFrame = 0;
+
+/*
+ * Close the open frame and the event array when the program exits
+ */
+static void closeTrace(){
+   if(inFrame){
+      traceEnd("frame", NULL);
+   }
+   fprintf(trace, "\n]\n");
+   fclose(trace);
+}
+
+/*
+ * Write one event, opening the file for the first one
+ */
+static void writeEvent(const char *name, char phase, const char *args){
+   // Chrome traces count in microseconds
+   double t = timerMillis() * 1000.0;
+
+   if(trace == NULL){
+      trace = fopen(traceFile, "w");
+      if(trace == NULL){
+         fprintf(stderr, "ERROR: Could not open %s to write the trace! Aborting!\n", traceFile);
+         exit(1);
+      }
+      startTime = t;
+      fprintf(trace, "[\n");
+      atexit(closeTrace);
+   } else {
+      fprintf(trace, ",\n");
+   }
+   fprintf(trace, "{\"name\": \"%s\", \"ph\": \"%c\", \"ts\": %.3f, \"pid\": 1, \"tid\": 1",
+      name, phase, t - startTime);
+   if(args != NULL){
+      fprintf(trace, ", \"args\": {%s}", args);
+   }
+   fprintf(trace, "}");
+}
+
+void traceBegin(const char *name){
+   if(traceFile == NULL){
+      return;
+   }
+   writeEvent(name, 'B', NULL);
+}
+
+void traceEnd(const char *name, const char *args){
+   if(traceFile == NULL){
+      return;
+   }
+   writeEvent(name, 'E', args);
+}
+
+void traceFrame(){
+   static int frame = 0;
+   char args[32];
+
+   if(traceFile == NULL){
+      return;
+   }
+   if(inFrame){
+      snprintf(args, sizeof(args), "\"frame\": %d", frame);
+      traceEnd("frame", args);
+      frame++;
+   }
+   traceBegin("frame");
+   inFrame = 1;
+}
@@ -0,0 +1,24 @@
+/*
+ * Trace of nested spans for -trace file, written as Chrome trace event
+ * JSON which chrome://tracing and Perfetto (ui.perfetto.dev) can open.
+ * Each span is a begin and end event on the main thread, spans must be
+ * ended in the reverse order they were begun.  Every call returns
+ * straight away when -trace was not given.
+ */
+
+/*
+ * Start a span called name
+ */
+void traceBegin(const char *name);
+
+/*
+ * End the span called name.  args is NULL or the members of a JSON object
+ * to tag the span with, e.g. "\"mob\": 2, \"length\": 14".
+ */
+void traceEnd(const char *name, const char *args);
+
+/*
+ * End the current frame span and begin the next one, called once at the
+ * end of display() so a frame covers everything up to the next redraw
+ */
+void traceFrame();
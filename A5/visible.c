@@ -9,9 +9,11 @@
 #include <math.h>
 
 #include "graphics.h"
-extern GLubyte  world[WORLDX][WORLDY][WORLDZ];
-
-#define OCTREE_LEVEL 1
+#include "frustum.h"
+#include "world.h"
+#include "stats.h"
+#include "workers.h"
+#include "camera.h"
 
 extern void gradphicsInit(int *, char **);
 extern void setLightPosition(GLfloat, GLfloat, GLfloat);
@@ -23,6 +25,18 @@ extern void getOldViewPosition(float *, float *, float *);
 extern void getViewOrientation(float *, float *, float *);
 
 extern int addDisplayList(int, int, int);
+extern void addChunkDisplayList(int, int, int);
+extern void sortDisplayList();
+extern void appendDisplayList(const unsigned int *, int);
+extern int chunkEmpty(int, int, int);
+
+extern int portalCull(float, float, float);
+extern int portalColumnVisible(int, int);
+extern int portalChunkVisible(int, int);
+extern int portalChunkList(int [][2]);
+
+extern void buildOcclusionBuffer(float, float, float);
+extern int boxOccluded(float, float, float, float, float, float);
 
 extern void createMob(int, float, float, float, float);
 extern void setMobPosition(int, float, float, float, float);
@@ -39,10 +53,19 @@ extern int flycontrol;
 	/* flag used to indicate that the test world should be used */
 extern int testWorld;
 	/* list and count of polygons to be displayed, set during culling */
-extern int displayList[MAX_DISPLAY_LIST][3];
+extern unsigned int *displayList;
 extern int displayCount;
+	/* list and count of chunks to be displayed, set during culling */
+extern int (*chunkDisplayList)[3];
+extern int chunkDisplayCount;
+	/* flag indicates chunk meshes are drawn instead of single cubes */
+extern int chunkRendering;
+	/* flag indicates boxes are tested against the CPU depth buffer */
+extern int occlusionCulling;
 	/* flag to print out frames per second */
 extern int fps;
+	/* flag indicates frames are drawn offscreen without GLUT */
+extern int benchMode;
 	/* flag indicates the program is a client when set = 1 */
 extern int netClient;
 	/* flag indicates the program is a server when set = 1 */
@@ -51,6 +74,17 @@ extern int netServer;
 	/* frustum corner coordinates */
 float corners[4][3];
 
+	/* set when a dungeon portal graph limits the visible columns */
+static int portalActive = 0;
+
+	/* returns 1 if occlusion culling is on and the box is hidden */
+static int occluded(float x0, float y0, float z0, float x1, float y1,
+   float z1) {
+   if (occlusionCulling == 0)
+      return(0);
+   return(boxOccluded(x0, y0, z0, x1, y1, z1));
+}
+
 /***********************/
 
 float lengthTwoPoints(float x1, float y1, float z1, float x2, float y2, float z2) {
@@ -132,37 +166,20 @@ int False = 0;
 
 void ExtractFrustum()
 {
-   float   proj[16];
-   float   modl[16];
-   float   clip[16];
+   const float *clip;
    float   t;
+   static int extracted = 0;
+   static unsigned int changes;
 
-   /* Get the current PROJECTION matrix from OpenGL */
-   glGetFloatv( GL_PROJECTION_MATRIX, proj );
+   /* the planes only change when the camera does, the matrices are */
+   /* kept on the CPU by camera.c so there is no read back from OpenGL */
+   if (extracted && (changes == cameraChanges()))
+      return;
+   extracted = 1;
+   changes = cameraChanges();
 
-   /* Get the current MODELVIEW matrix from OpenGL */
-   glGetFloatv( GL_MODELVIEW_MATRIX, modl );
-
-   /* Combine the two matrices (multiply projection by modelview) */
-   clip[ 0] = modl[ 0] * proj[ 0] + modl[ 1] * proj[ 4] + modl[ 2] * proj[ 8] + modl[ 3] * proj[12];
-   clip[ 1] = modl[ 0] * proj[ 1] + modl[ 1] * proj[ 5] + modl[ 2] * proj[ 9] + modl[ 3] * proj[13];
-   clip[ 2] = modl[ 0] * proj[ 2] + modl[ 1] * proj[ 6] + modl[ 2] * proj[10] + modl[ 3] * proj[14];
-   clip[ 3] = modl[ 0] * proj[ 3] + modl[ 1] * proj[ 7] + modl[ 2] * proj[11] + modl[ 3] * proj[15];
-
-   clip[ 4] = modl[ 4] * proj[ 0] + modl[ 5] * proj[ 4] + modl[ 6] * proj[ 8] + modl[ 7] * proj[12];
-   clip[ 5] = modl[ 4] * proj[ 1] + modl[ 5] * proj[ 5] + modl[ 6] * proj[ 9] + modl[ 7] * proj[13];
-   clip[ 6] = modl[ 4] * proj[ 2] + modl[ 5] * proj[ 6] + modl[ 6] * proj[10] + modl[ 7] * proj[14];
-   clip[ 7] = modl[ 4] * proj[ 3] + modl[ 5] * proj[ 7] + modl[ 6] * proj[11] + modl[ 7] * proj[15];
-
-   clip[ 8] = modl[ 8] * proj[ 0] + modl[ 9] * proj[ 4] + modl[10] * proj[ 8] + modl[11] * proj[12];
-   clip[ 9] = modl[ 8] * proj[ 1] + modl[ 9] * proj[ 5] + modl[10] * proj[ 9] + modl[11] * proj[13];
-   clip[10] = modl[ 8] * proj[ 2] + modl[ 9] * proj[ 6] + modl[10] * proj[10] + modl[11] * proj[14];
-   clip[11] = modl[ 8] * proj[ 3] + modl[ 9] * proj[ 7] + modl[10] * proj[11] + modl[11] * proj[15];
-
-   clip[12] = modl[12] * proj[ 0] + modl[13] * proj[ 4] + modl[14] * proj[ 8] + modl[15] * proj[12];
-   clip[13] = modl[12] * proj[ 1] + modl[13] * proj[ 5] + modl[14] * proj[ 9] + modl[15] * proj[13];
-   clip[14] = modl[12] * proj[ 2] + modl[13] * proj[ 6] + modl[14] * proj[10] + modl[15] * proj[14];
-   clip[15] = modl[12] * proj[ 3] + modl[13] * proj[ 7] + modl[14] * proj[11] + modl[15] * proj[15];
+   /* Combined projection and modelview matrix */
+   clip = cameraClipMatrix();
 
    /* Extract the numbers for the RIGHT plane */
    frustum[0][0] = clip[ 3] - clip[ 0];
@@ -322,69 +339,590 @@ int CubeInFrustum2( float x, float y, float z, float size )
 
 
 // if frustum test shows box in view
-//    if level == max level then draw contents of cube
-//    else call 8 subdivisions, increment level
+//    if the box is a brick then test and draw the cubes in it
+//    else test the occupied subdivisions against the planes the box crosses
+// a box found completely inside the frustum is not tested again below it
 // assumes all t[xyz] are larger than b[xyz] respectively
 
-void tree(float bx, float by, float bz, float tx, float ty, float tz,
-   int level) {
-float length;
-float newCentrex, newCentrey, newCentrez;
-int i, j, k;
+	/* area of the world covered by the current tree() call */
+static float treeMin[3], treeMax[3];
+
+	/* occupancy level at which the octree is split into jobs for the */
+	/* worker threads, 32 cube nodes give up to 32 jobs for a 100x50x100 */
+	/* world */
+#define CULLJOBLEVEL 3
+#define CULLJOBSIZE (BRICKSIZE << CULLJOBLEVEL)
+
+	/* a node handed to a worker and the cubes it found, each job only */
+	/* writes to its own list and counts so no locking is needed */
+struct cullJob {
+   int level, x, y, z, planes;
+   int count, size;
+   unsigned int *cubes;
+   struct renderStats stats;
+};
+	/* room for one job per CULLJOBLEVEL node, see initCulling() */
+static struct cullJob *cullJobs = NULL;
+static int cullJobCount = 0;
+static int cullJobMax = 0;
+	/* nodes found after the job list is full are walked right away */
+	/* on the calling thread into this list */
+static struct cullJob cullOverflow;
+
+	/* number of threads to cull with, 0 uses one per processor */
+extern int cullThreads;
+
+	/* add a visible cube to a job's list */
+static void addJobCube(struct cullJob *job, int x, int y, int z) {
+   if (job->count == job->size) {
+      job->size = (job->size == 0) ? 1024 : job->size * 2;
+      job->cubes = realloc(job->cubes, sizeof(unsigned int) * job->size);
+      if (job->cubes == NULL) {
+         printf("Could not grow the culling job list.\n");
+         exit(1);
+      }
+   }
+   job->cubes[job->count++] = PACKCUBE(x, y, z);
+}
+
+	/* returns 1 if the occupancy node covering cubes lo to hi-1 */
+	/* overlaps the tree() area on every axis */
+static int nodeInArea(int lo[3], int hi[3]) {
+int a;
 
-	/* find length of cube edge */
-   length = (tx - bx) / 2.0;
-   if (length < 0) length *= -1;
-
-	/* if the octree cube is in the frustum then */
-	/* if the bottom octree level is reached then */
-	/* if the visible cube is not empty and is not surrounded then */
-	/* add to the display list */ 
-   if (CubeInFrustum(bx + ((tx-bx)/2), by + ((ty-by)/2), bz + ((tz-bz)/2), length )) {
-      if (level == OCTREE_LEVEL) {
-		/* draw cubes */
-        for(i=bx; i<tx+1; i++)
-           for(j=by; j<ty+1; j++)
-              for(k=bz; k<tz+1; k++) {
-                 if ((i<WORLDX) && (j<WORLDY) && (k<WORLDZ) && (i>-1) && (j>-1) && (k>-1))
-                    if ( (world[i][j][k] != 0) &&
-                        (CubeInFrustum(i+0.5, j+0.5, k+0.5, 0.5))  ) {
-				/* check for six neighbours */
-				/* if cube is not on the outer edge and is not*/
-				/*   surrounded by 6 neighbours then draw it */
-				/* else if the cube is an outside cube then */
-				/*    always draw it */
-                       if ( (i > 0) && (i < WORLDX-1) &&
-                            (j > 0) && (j < WORLDY-1) &&
-                            (k > 0) && (k < WORLDZ-1) && 
-                         ((world[i+1][j][k] == 0) || (world[i-1][j][k] == 0) 
-                         || (world[i][j+1][k] == 0) || (world[i][j-1][k] == 0) 
-                         || (world[i][j][k+1] == 0) || (world[i][j][k-1] == 0)))
-                             addDisplayList(i, j, k);
-                       else if ( (i == 0) || (i == WORLDX-1) ||
-                                 (j == 0) || (j == WORLDY-1) ||
-                                 (k == 0) || (k == WORLDZ-1) ) 
-                               addDisplayList(i, j, k);
-                 }
-              }
+   for(a=0; a<3; a++)
+      if ((hi[a] - 1 < treeMin[a]) || (lo[a] > treeMax[a]))
+         return(0);
+   return(1);
+}
+
+	/* test the exposed cubes of a brick against the planes it */
+	/* crosses and add the visible ones to the display list */
+static void treeBrick(int nx, int ny, int nz, int planes,
+   struct cullJob *out) {
+float cx[BRICKSIZE*BRICKSIZE*BRICKSIZE], cy[BRICKSIZE*BRICKSIZE*BRICKSIZE];
+float cz[BRICKSIZE*BRICKSIZE*BRICKSIZE], ex[BRICKSIZE*BRICKSIZE*BRICKSIZE];
+unsigned char result[BRICKSIZE*BRICKSIZE*BRICKSIZE];
+const GLubyte *run;
+int i, j, k, n, count;
+
+	/* faceMask is 0 for empty cubes and for cubes */
+	/* surrounded by 6 neighbours, gather the rest */
+	/* a brick lies inside one world tile so each run along z */
+	/* is contiguous in faceMask */
+   count = 0;
+   for(i=nx*BRICKSIZE; i<(nx+1)*BRICKSIZE; i++)
+      for(j=ny*BRICKSIZE; j<(ny+1)*BRICKSIZE; j++) {
+         if ((i>=WORLDX) || (j>=WORLDY))
+            continue;
+         run = &faceMask[worldIndex(i, j, nz*BRICKSIZE)];
+         for(k=nz*BRICKSIZE; k<(nz+1)*BRICKSIZE; k++) {
+            if (k>=WORLDZ)
+               continue;
+            if ((i<treeMin[0]) || (i>treeMax[0]) || (j<treeMin[1]) ||
+                (j>treeMax[1]) || (k<treeMin[2]) || (k>treeMax[2]))
+               continue;
+            if (run[k - nz*BRICKSIZE] != 0) {
+               cx[count] = i + 0.5;
+               cy[count] = j + 0.5;
+               cz[count] = k + 0.5;
+               ex[count] = 0.5;
+               count++;
+            }
+         }
+      }
+
+	/* a brick inside all of the planes needs no tests */
+   if (planes != 0)
+      frustumTestBoxesMasked(count, cx, cy, cz, ex, ex, ex, planes, result,
+         NULL);
+   out->stats.cubesTested += count;
+   for(n=0; n<count; n++) {
+      if (((planes == 0) || (result[n] != 0)) &&
+          !occluded(cx[n]-0.5, cy[n]-0.5, cz[n]-0.5,
+             cx[n]+0.5, cy[n]+0.5, cz[n]+0.5))
+         addJobCube(out, (int) cx[n], (int) cy[n], (int) cz[n]);
+      else
+         out->stats.cubesCulled++;
+   }
+}
+
+	/* walk an occupied octree node which is in view, planes holds */
+	/* the frustum planes the node crosses, when out is NULL the nodes */
+	/* at CULLJOBLEVEL are saved as jobs instead of being walked */
+static void treeNode(int level, int nx, int ny, int nz, int planes,
+   struct cullJob *out) {
+float cx[8], cy[8], cz[8], ex[8];
+unsigned char result[8], masks[8];
+int child[8][3];
+int lo[3], hi[3];
+int n, count, size;
+	/* the top of the walk runs on the main thread and counts directly */
+struct renderStats *stats = (out == NULL) ? &frameStats : &out->stats;
+
+   if ((out == NULL) && (level <= CULLJOBLEVEL)) {
+      if (cullJobCount < cullJobMax) {
+         cullJobs[cullJobCount].level = level;
+         cullJobs[cullJobCount].x = nx;
+         cullJobs[cullJobCount].y = ny;
+         cullJobs[cullJobCount].z = nz;
+         cullJobs[cullJobCount].planes = planes;
+         cullJobs[cullJobCount].count = 0;
+         memset(&cullJobs[cullJobCount].stats, 0, sizeof(struct renderStats));
+         cullJobCount++;
+      } else
+         treeNode(level, nx, ny, nz, planes, &cullOverflow);
+      return;
+   }
+   if (level == 0) {
+      treeBrick(nx, ny, nz, planes, out);
+      return;
+   }
+
+	/* gather the subdivisions with something in them */
+   level--;
+   size = BRICKSIZE << level;
+   count = 0;
+   for(n=0; n<8; n++) {
+      child[count][0] = nx*2 + (n & 1);
+      child[count][1] = ny*2 + ((n >> 2) & 1);
+      child[count][2] = nz*2 + ((n >> 1) & 1);
+      if (occupiedCount(level, child[count][0], child[count][1],
+             child[count][2]) == 0)
+         continue;
+      lo[0] = child[count][0] * size;
+      lo[1] = child[count][1] * size;
+      lo[2] = child[count][2] * size;
+      hi[0] = lo[0] + size;
+      hi[1] = lo[1] + size;
+      hi[2] = lo[2] + size;
+      if (!nodeInArea(lo, hi))
+         continue;
+      ex[count] = size / 2.0;
+      cx[count] = lo[0] + ex[count];
+      cy[count] = lo[1] + ex[count];
+      cz[count] = lo[2] + ex[count];
+      count++;
+   }
+
+	/* only the planes the parent crosses are tested */
+   if (planes != 0)
+      frustumTestBoxesMasked(count, cx, cy, cz, ex, ex, ex, planes, result,
+         masks);
+   stats->nodesVisited[level] += count;
+   for(n=0; n<count; n++) {
+      if (planes == 0)
+         masks[n] = 0;
+      else if (result[n] == 0) {
+         stats->nodesCulled[level]++;
+         continue;
+      }
+      if (!occluded(cx[n]-ex[n], cy[n]-ex[n], cz[n]-ex[n],
+             cx[n]+ex[n], cy[n]+ex[n], cz[n]+ex[n]))
+         treeNode(level, child[n][0], child[n][1], child[n][2], masks[n],
+            out);
+      else
+         stats->nodesCulled[level]++;
+   }
+}
+
+	/* worker thread job, walk one of the saved nodes */
+static void cullJob(int n) {
+struct cullJob *job = &cullJobs[n];
+
+   treeNode(job->level, job->x, job->y, job->z, job->planes, job);
+}
+
+	/* the walk starts from the top occupancy node and stops early in */
+	/* empty or fully visible space, the top of the octree is walked */
+	/* here and the nodes below it are culled in parallel by the */
+	/* worker threads */
+void tree(float bx, float by, float bz, float tx, float ty, float tz) {
+float cx, cy, cz, ex;
+unsigned char result, mask;
+int top = occupancyLevels - 1;
+int n;
+
+   initWorkers(cullThreads);
+
+   treeMin[0] = bx;
+   treeMin[1] = by;
+   treeMin[2] = bz;
+   treeMax[0] = tx;
+   treeMax[1] = ty;
+   treeMax[2] = tz;
+
+	/* if the world is empty or out of view there is nothing to do */
+   if (occupiedCount(top, 0, 0, 0) == 0)
+      return;
+   ex = (BRICKSIZE << top) / 2.0;
+   cx = cy = cz = ex;
+   frustumTestBoxesMasked(1, &cx, &cy, &cz, &ex, &ex, &ex,
+      FRUSTUM_ALLPLANES, &result, &mask);
+   frameStats.nodesVisited[top]++;
+   if ((result == 0) || occluded(0, 0, 0, 2*ex, 2*ex, 2*ex)) {
+      frameStats.nodesCulled[top]++;
+      return;
+   }
+
+	/* collect the jobs, cull them, then merge the lists in job order */
+	/* so the display list is the same whatever the thread count */
+   cullJobCount = 0;
+   cullOverflow.count = 0;
+   memset(&cullOverflow.stats, 0, sizeof(struct renderStats));
+   treeNode(top, 0, 0, 0, mask, NULL);
+   runWorkers(cullJob, cullJobCount);
+   for(n=0; n<cullJobCount; n++) {
+      appendDisplayList(cullJobs[n].cubes, cullJobs[n].count);
+      statsAddCulling(&cullJobs[n].stats);
+   }
+   appendDisplayList(cullOverflow.cubes, cullOverflow.count);
+   statsAddCulling(&cullOverflow.stats);
+}
+
+
+	/* the octree nodes at CHUNKLEVEL are the same boxes as the chunks */
+#define CHUNKLEVEL 2
+#if (BRICKSIZE << CHUNKLEVEL) != CHUNKSIZE
+#error "CHUNKSIZE must match the occupancy nodes at CHUNKLEVEL"
+#endif
+
+	/* room to test every chunk against the frustum at once, CHUNKCOUNT */
+	/* of each, shared by chunkTree(), pvsTree() and classifyChunks() */
+static int (*chunkFound)[3] = NULL;
+static float *chunkX = NULL, *chunkY = NULL, *chunkZ = NULL;
+static float *chunkHalf = NULL;
+static unsigned char *chunkResult = NULL;
+	/* chunk columns to look at, CHUNKX * CHUNKZ of them */
+static int (*chunkColumns)[2] = NULL;
+
+	/* adds each chunk which is not empty and is in the frustum to */
+	/* the chunkDisplayList */
+void chunkTree() {
+int i, j, k, n, count, found;
+int (*list)[2] = chunkColumns;
+int (*chunk)[3] = chunkFound;
+float *cx = chunkX, *cy = chunkY, *cz = chunkZ;
+unsigned char *result = chunkResult;
+float half = CHUNKSIZE / 2.0;
+
+	/* on dungeon floors only the chunk columns in the PVS of the */
+	/* player's region are checked */
+   if (portalActive) {
+      count = portalChunkList(list);
    } else {
-		/* calculate centre of new cube */
-         newCentrex = bx + ((tx - bx) / 2.0);
-         newCentrey = by + ((ty - by) / 2.0);
-         newCentrez = bz + ((tz - bz) / 2.0);
-		/* call recursive tree functions, increment level */
-         level++;
-         tree(bx, by, bz, newCentrex, newCentrey, newCentrez, level);
-         tree(newCentrex, by, bz, tx, newCentrey, newCentrez, level);
-         tree(bx, by, newCentrez, newCentrex, newCentrey, tz, level);
-         tree(newCentrex, by, newCentrez, tx, newCentrey, tz, level);
-         tree(bx, newCentrey, bz, newCentrex, ty, newCentrez, level);
-         tree(newCentrex, newCentrey, bz, tx, ty, newCentrez, level);
-         tree(bx, newCentrey, newCentrez, newCentrex, ty, tz, level);
-         tree(newCentrex, newCentrey, newCentrez, tx, ty, tz, level);
+      count = 0;
+      for(i=0; i<CHUNKX; i++)
+         for(k=0; k<CHUNKZ; k++) {
+            list[count][0] = i;
+            list[count][1] = k;
+            count++;
+         }
+   }
+
+	/* gather the chunks with something in them */
+   found = 0;
+   for(n=0; n<count; n++) {
+      i = list[n][0];
+      k = list[n][1];
+      if (portalActive && !portalChunkVisible(i, k))
+         continue;
+      for(j=0; j<CHUNKY; j++) {
+         if (chunkEmpty(i, j, k))
+            continue;
+         chunk[found][0] = i;
+         chunk[found][1] = j;
+         chunk[found][2] = k;
+         cx[found] = i*CHUNKSIZE + half;
+         cy[found] = j*CHUNKSIZE + half;
+         cz[found] = k*CHUNKSIZE + half;
+         found++;
+      }
+   }
+
+	/* test them against the frustum together */
+   frustumTestCubes(found, cx, cy, cz, half, result);
+   frameStats.nodesVisited[CHUNKLEVEL] += found;
+   for(n=0; n<found; n++) {
+      i = chunk[n][0];
+      j = chunk[n][1];
+      k = chunk[n][2];
+      if ((result[n] != 0) &&
+          !occluded(i*CHUNKSIZE, j*CHUNKSIZE, k*CHUNKSIZE,
+             (i+1)*CHUNKSIZE, (j+1)*CHUNKSIZE, (k+1)*CHUNKSIZE))
+         addChunkDisplayList(i, j, k);
+      else
+         frameStats.nodesCulled[CHUNKLEVEL]++;
+   }
+}
+
+
+	/* exposed cubes of one chunk gathered by pvsTree() so they can */
+	/* be tested against the frustum together */
+#define PVSCUBES (CHUNKSIZE * CHUNKSIZE * CHUNKSIZE)
+static float pvsX[PVSCUBES], pvsY[PVSCUBES], pvsZ[PVSCUBES];
+static unsigned char pvsResult[PVSCUBES];
+
+	/* adds the visible cubes of the chunk columns in the PVS of the */
+	/* player's region to the displayList, used instead of the octree */
+	/* on dungeon floors */
+void pvsTree() {
+int i, j, k, n, m, count, found, cubes;
+int x, y, z;
+int (*list)[2] = chunkColumns;
+int (*chunk)[3] = chunkFound;
+float *cx = chunkX, *cy = chunkY, *cz = chunkZ;
+unsigned char *result = chunkResult;
+float half = CHUNKSIZE / 2.0;
+
+	/* gather the chunks of the visible columns and test them */
+	/* against the frustum together */
+   count = portalChunkList(list);
+   found = 0;
+   for(n=0; n<count; n++) {
+      i = list[n][0];
+      k = list[n][1];
+      if (!portalChunkVisible(i, k))
+         continue;
+      for(j=0; j<CHUNKY; j++) {
+         chunk[found][0] = i;
+         chunk[found][1] = j;
+         chunk[found][2] = k;
+         cx[found] = i*CHUNKSIZE + half;
+         cy[found] = j*CHUNKSIZE + half;
+         cz[found] = k*CHUNKSIZE + half;
+         found++;
+      }
+   }
+   frustumTestCubes(found, cx, cy, cz, half, result);
+   frameStats.nodesVisited[CHUNKLEVEL] += found;
+
+   for(n=0; n<found; n++) {
+      i = chunk[n][0];
+      j = chunk[n][1];
+      k = chunk[n][2];
+      if ((result[n] == 0) ||
+          occluded(i*CHUNKSIZE, j*CHUNKSIZE, k*CHUNKSIZE,
+             (i+1)*CHUNKSIZE, (j+1)*CHUNKSIZE, (k+1)*CHUNKSIZE)) {
+         frameStats.nodesCulled[CHUNKLEVEL]++;
+         continue;
+      }
+
+	/* gather the exposed cubes of the chunk in visible columns */
+      cubes = 0;
+      for(x=i*CHUNKSIZE; x<(i+1)*CHUNKSIZE && x<WORLDX; x++)
+         for(z=k*CHUNKSIZE; z<(k+1)*CHUNKSIZE && z<WORLDZ; z++) {
+            if (!portalColumnVisible(x, z))
+               continue;
+            for(y=j*CHUNKSIZE; y<(j+1)*CHUNKSIZE && y<WORLDY; y++) {
+               if (faceMaskGet(x, y, z) == 0)
+                  continue;
+               pvsX[cubes] = x + 0.5;
+               pvsY[cubes] = y + 0.5;
+               pvsZ[cubes] = z + 0.5;
+               cubes++;
+            }
+         }
+
+      frustumTestCubes(cubes, pvsX, pvsY, pvsZ, 0.5, pvsResult);
+      frameStats.cubesTested += cubes;
+      for(m=0; m<cubes; m++) {
+         x = (int) pvsX[m];
+         y = (int) pvsY[m];
+         z = (int) pvsZ[m];
+         if ((pvsResult[m] != 0) && !occluded(x, y, z, x+1, y+1, z+1))
+            addDisplayList(x, y, z);
+         else
+            frameStats.cubesCulled++;
       }
    }
+}
+
+
+	/* largest move and turn of the viewpoint for which the visible */
+	/* cubes are updated a chunk at a time instead of walking the tree */
+#define CACHEMOVE 2.0
+#define CACHETURN 10.0
+
+	/* view and world the display lists were built for, frustum[][] */
+	/* covers the view position, orientation and window shape */
+static int cacheValid = 0;
+static float cacheFrustum[6][4];
+static float cachePos[3], cacheRot[3];
+static unsigned int cacheGeneration;
+	/* set when the view has changed since the last display lists */
+static int cacheMoved = 1;
+
+	/* the visible cubes of each chunk, whether the chunk was inside */
+	/* crossing or outside of the frustum and its edit generation when they */
+	/* were found, only kept up to date for the octree */
+#define CHUNKOUT 0
+#define CHUNKPART 1
+#define CHUNKIN 2
+	/* all are CHUNKCOUNT long and indexed by CHUNKINDEX() */
+static int chunksValid = 0;
+static int *chunkState = NULL;
+static unsigned int *chunkGenerationSeen = NULL;
+static struct cullJob *chunkCubes = NULL;
+	/* the states and crossing planes classifyChunks() found this frame */
+static int *chunkNewState = NULL;
+static unsigned char *chunkMasks = NULL;
+
+	/* returns 1 if nothing has changed since the display lists were */
+	/* built, otherwise records the new view and world */
+static int cacheCurrent() {
+   cacheMoved = !cacheValid ||
+      (memcmp(cacheFrustum, frustum, sizeof(frustum)) != 0);
+   if (!cacheMoved && (cacheGeneration == worldGeneration()))
+      return(1);
+   memcpy(cacheFrustum, frustum, sizeof(frustum));
+   cacheGeneration = worldGeneration();
+   return(0);
+}
+
+	/* returns 1 if the viewpoint is close enough to the last one that */
+	/* updating the chunks which changed is cheaper than a new walk */
+static int smallMove(float pos[3], float rot[3]) {
+int i;
+
+   for(i=0; i<3; i++) {
+      if ((fabsf(pos[i] - cachePos[i]) > CACHEMOVE) ||
+          (fabsf(rot[i] - cacheRot[i]) > CACHETURN))
+         return(0);
+   }
+   return(1);
+}
+
+	/* sort the chunks into inside, crossing or outside of the frustum */
+	/* into chunkNewState, chunkMasks holds the planes each crossing */
+	/* chunk is cut by */
+static void classifyChunks() {
+float *cx = chunkX, *cy = chunkY, *cz = chunkZ, *ex = chunkHalf;
+unsigned char *result = chunkResult;
+int i, j, k, n;
+
+   n = 0;
+   for(i=0; i<CHUNKX; i++)
+      for(j=0; j<CHUNKY; j++)
+         for(k=0; k<CHUNKZ; k++) {
+            ex[n] = CHUNKSIZE / 2.0;
+            cx[n] = i*CHUNKSIZE + ex[n];
+            cy[n] = j*CHUNKSIZE + ex[n];
+            cz[n] = k*CHUNKSIZE + ex[n];
+            n++;
+         }
+   frustumTestBoxesMasked(CHUNKCOUNT, cx, cy, cz, ex, ex, ex,
+      FRUSTUM_ALLPLANES, result, chunkMasks);
+   frameStats.nodesVisited[CHUNKLEVEL] += CHUNKCOUNT;
+   for(n=0; n<CHUNKCOUNT; n++) {
+      if (result[n] == 0) {
+         chunkNewState[n] = CHUNKOUT;
+         frameStats.nodesCulled[CHUNKLEVEL]++;
+      } else if (chunkMasks[n] == 0)
+         chunkNewState[n] = CHUNKIN;
+      else
+         chunkNewState[n] = CHUNKPART;
+   }
+}
+
+	/* after a full walk of the octree, split the displayList into the */
+	/* chunks so later frames can update it a chunk at a time */
+static void fillChunks() {
+int i, j, k, n;
+
+   classifyChunks();
+   for(n=0; n<CHUNKCOUNT; n++)
+      chunkCubes[n].count = 0;
+   n = 0;
+   for(i=0; i<CHUNKX; i++)
+      for(j=0; j<CHUNKY; j++)
+         for(k=0; k<CHUNKZ; k++) {
+            chunkState[n] = chunkNewState[n];
+            chunkGenerationSeen[n] = chunkGeneration(i, j, k);
+            n++;
+         }
+   for(n=0; n<displayCount; n++) {
+      i = CUBEX(displayList[n]);
+      j = CUBEY(displayList[n]);
+      k = CUBEZ(displayList[n]);
+      addJobCube(&chunkCubes[CHUNKINDEX(i/CHUNKSIZE, j/CHUNKSIZE, k/CHUNKSIZE)],
+         i, j, k);
+   }
+   chunksValid = 1;
+}
+
+	/* find the visible cubes again only in the chunks which have been */
+	/* edited, or which are not still fully inside the frustum after the */
+	/* view has moved, then rebuild the displayList from the chunk lists */
+static void updateChunkCubes() {
+struct cullJob *chunk;
+int i, j, k, n, state;
+
+   treeMin[0] = treeMin[1] = treeMin[2] = 0.0;
+   treeMax[0] = WORLDX;
+   treeMax[1] = WORLDY;
+   treeMax[2] = WORLDZ;
+
+   classifyChunks();
+   n = 0;
+   for(i=0; i<CHUNKX; i++)
+      for(j=0; j<CHUNKY; j++)
+         for(k=0; k<CHUNKZ; k++) {
+            chunk = &chunkCubes[n];
+            state = chunkNewState[n];
+            if (state == CHUNKOUT)
+               chunk->count = 0;
+            else if ((chunkGenerationSeen[n] != chunkGeneration(i, j, k)) ||
+                (state != chunkState[n]) ||
+                (cacheMoved && (state != CHUNKIN))) {
+               chunk->count = 0;
+               if (occupiedCount(CHUNKLEVEL, i, j, k) != 0)
+                  treeNode(CHUNKLEVEL, i, j, k, chunkMasks[n], chunk);
+               statsAddCulling(&chunk->stats);
+            }
+            chunkState[n] = state;
+            chunkGenerationSeen[n] = chunkGeneration(i, j, k);
+            n++;
+         }
+
+   displayCount = 0;
+   for(n=0; n<CHUNKCOUNT; n++)
+      appendDisplayList(chunkCubes[n].cubes, chunkCubes[n].count);
+}
+
+
+	/* allocate a zeroed array of count items of size for culling */
+static void *cullArray(int count, size_t size) {
+void *p;
+
+   p = calloc(count, size);
+   if (p == NULL) {
+      printf("Could not allocate the culling arrays.\n");
+      exit(1);
+   }
+   return(p);
+}
 
+	/* allocate the culling jobs and per chunk lists for the world size */
+void initCulling() {
+   cullJobMax = ((WORLDX + CULLJOBSIZE - 1) / CULLJOBSIZE) *
+      ((WORLDY + CULLJOBSIZE - 1) / CULLJOBSIZE) *
+      ((WORLDZ + CULLJOBSIZE - 1) / CULLJOBSIZE);
+   cullJobs = cullArray(cullJobMax, sizeof(struct cullJob));
+
+   chunkFound = cullArray(CHUNKCOUNT, sizeof(int) * 3);
+   chunkX = cullArray(CHUNKCOUNT, sizeof(float));
+   chunkY = cullArray(CHUNKCOUNT, sizeof(float));
+   chunkZ = cullArray(CHUNKCOUNT, sizeof(float));
+   chunkHalf = cullArray(CHUNKCOUNT, sizeof(float));
+   chunkResult = cullArray(CHUNKCOUNT, sizeof(unsigned char));
+   chunkColumns = cullArray(CHUNKX * CHUNKZ, sizeof(int) * 2);
+
+   chunkState = cullArray(CHUNKCOUNT, sizeof(int));
+   chunkGenerationSeen = cullArray(CHUNKCOUNT, sizeof(unsigned int));
+   chunkCubes = cullArray(CHUNKCOUNT, sizeof(struct cullJob));
+   chunkNewState = cullArray(CHUNKCOUNT, sizeof(int));
+   chunkMasks = cullArray(CHUNKCOUNT, sizeof(unsigned char));
 }
 
 
@@ -394,26 +932,67 @@ int i, j, k;
 void buildDisplayList() {
 int i, j, k;
 float newx, newy, newz;
+float pos[3], rot[3];
         /* used to calculate frames per second */
 static int frame=0, time, timebase=0;
 
    getViewPosition(&newx, &newy, &newz);
+   pos[0] = -newx;
+   pos[1] = -newy;
+   pos[2] = -newz;
+   getViewOrientation(&rot[0], &rot[1], &rot[2]);
 
 
         /* calculate frustum for current viewpoint, store in frustum[][] */
    ExtractFrustum();
 
+	/* reuse the last display lists if the view and world are the same */
+   if (cacheCurrent() == 0) {
+
+	/* on dungeon floors only the rooms seen through open doors */
+	/* are drawn, the view position is negated world coordinates */
+      portalActive = portalCull(-newx, -newy, -newz);
+
+	/* fill the CPU depth buffer with the solid columns nearby */
+      if (occlusionCulling == 1)
+         buildOcclusionBuffer(-newx, -newy, -newz);
+
         /* octree, used to determine if regions are visible */
         /* stores visible cubes in a display list */
-   displayCount = 0;
-   tree(0.0, 0.0, 0.0, (float) WORLDX, (float) WORLDY, (float) WORLDZ, 0);
+      displayCount = 0;
+      chunkDisplayCount = 0;
+      if (chunkRendering == 1) {
+         chunkTree();
+         chunksValid = 0;
+      } else if (portalActive == 1) {
+         pvsTree();
+         chunksValid = 0;
+      } else if ((occlusionCulling == 0) && chunksValid && cacheValid &&
+                 smallMove(pos, rot)) {
+	/* small moves only look again at the chunks which changed */
+         updateChunkCubes();
+      } else {
+         tree(0.0, 0.0, 0.0, (float) WORLDX, (float) WORLDY, (float) WORLDZ);
+         if (occlusionCulling == 0)
+            fillChunks();
+         else
+            chunksValid = 0;
+      }
+	/* group cubes by colour so materials are only set once each */
+      if (chunkRendering == 0)
+         sortDisplayList();
+
+      memcpy(cachePos, pos, sizeof(cachePos));
+      memcpy(cacheRot, rot, sizeof(cacheRot));
+      cacheValid = 1;
+   }
 
 
         /* frame per second calculation */
         /* don't change the following routine */
         /* Code taken from : */
         /* http://www.lighthouse3d.com/opengl/glut/index.php?fps */
-   if (fps == 1) {
+   if ((fps == 1) && (benchMode == 0)) {
       frame++;
       time=glutGet(GLUT_ELAPSED_TIME);
       if (time - timebase > 1000) {
@@ -424,6 +1003,7 @@ static int frame=0, time, timebase=0;
    }
 
         /* redraw the screen at the end of the update */
-   glutPostRedisplay();
+   if (benchMode == 0)
+      glutPostRedisplay();
 }
 
@@ -42,13 +42,21 @@ int CubeInFrustum2( float x, float y, float z, float size );
 
 
 
-// if frustum test shows box in view
-//    if level == max level then draw contents of cube
-//    else call 8 subdivisions, increment level
+// walk the occupancy octree from the top node down, culling nodes
+// outside of the frustum and adding the visible cubes in (b[xyz],t[xyz])
+// to the display list
 // assumes all t[xyz] are larger than b[xyz] respectively
 
-void tree(float bx, float by, float bz, float tx, float ty, float tz,
-   int level);
+void tree(float bx, float by, float bz, float tx, float ty, float tz);
+
+
+	/* adds the chunks which are in the frustum to the chunkDisplayList */
+void chunkTree();
+
+
+	/* allocate the culling jobs and per chunk lists for the world */
+	/* size, called by graphicsInit() after initWorld() */
+void initCulling();
 
 
         /* determines which cubes are to be drawn and puts them into */
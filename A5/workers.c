@@ -0,0 +1,120 @@
+/* Worker thread pool */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "workers.h"
+
+// Threads started, the caller is not counted
+static pthread_t threads[MAXWORKERS];
+static int threadCount = 0;
+static int started = 0;
+
+// Current batch of jobs
+static void (*jobFunction)(int) = NULL;
+static int jobCount = 0;
+static volatile int nextJob = 0;
+
+// Each batch bumps the generation to wake the threads, pending counts the
+// threads still working on it
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t poolStart = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t poolDone = PTHREAD_COND_INITIALIZER;
+static int generation = 0;
+static int pending = 0;
+
+/*
+ * Take jobs until there are none left
+ */
+static void takeJobs(){
+   int job;
+
+   while((job = __sync_fetch_and_add(&nextJob, 1)) < jobCount){
+      jobFunction(job);
+   }
+}
+
+/*
+ * Worker thread, sleeps until a batch is started
+ */
+static void *workerMain(void *arg){
+   int seen = 0;
+
+   (void)arg;
+   while(1){
+      pthread_mutex_lock(&poolLock);
+      while(generation == seen){
+         pthread_cond_wait(&poolStart, &poolLock);
+      }
+      seen = generation;
+      pthread_mutex_unlock(&poolLock);
+
+      takeJobs();
+
+      pthread_mutex_lock(&poolLock);
+      pending--;
+      if(pending == 0){
+         pthread_cond_signal(&poolDone);
+      }
+      pthread_mutex_unlock(&poolLock);
+   }
+   return NULL;
+}
+
+void initWorkers(int count){
+   int i;
+
+   if(started){
+      return;
+   }
+   started = 1;
+   if(count <= 0){
+      count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+   }
+   if(count < 1){
+      count = 1;
+   }
+   if(count > MAXWORKERS){
+      count = MAXWORKERS;
+   }
+   for(i = 0; i < count - 1; i++){
+      if(pthread_create(&threads[threadCount], NULL, workerMain, NULL) != 0){
+         printf("Could not start worker thread, using %d threads.\n", threadCount + 1);
+         break;
+      }
+      pthread_detach(threads[threadCount]);
+      threadCount++;
+   }
+}
+
+int workerCount(){
+   return threadCount + 1;
+}
+
+void runWorkers(void (*job)(int), int count){
+   jobFunction = job;
+   jobCount = count;
+   nextJob = 0;
+
+   // Nothing to share, run it here
+   if(threadCount == 0 || count <= 1){
+      takeJobs();
+      return;
+   }
+
+   pthread_mutex_lock(&poolLock);
+   pending = threadCount;
+   generation++;
+   pthread_cond_broadcast(&poolStart);
+   pthread_mutex_unlock(&poolLock);
+
+   takeJobs();
+
+   pthread_mutex_lock(&poolLock);
+   while(pending > 0){
+      pthread_cond_wait(&poolDone, &poolLock);
+   }
+   pthread_mutex_unlock(&poolLock);
+}
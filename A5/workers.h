@@ -0,0 +1,27 @@
+/*
+ * Small pool of worker threads for splitting per frame work (culling).
+ * The calling thread takes jobs as well, so a pool of one thread runs
+ * everything on the caller.  Jobs are handed out with an atomic counter,
+ * each job should only write to data it owns.
+ */
+
+	/* most threads the pool will use, including the caller */
+#define MAXWORKERS 16
+
+/*
+ * Start the pool with count threads in total (including the caller).
+ * A count of 0 uses one thread per processor.  Safe to call again, later
+ * calls do nothing.
+ */
+void initWorkers(int count);
+
+/*
+ * Number of threads jobs are spread over, including the caller
+ */
+int workerCount();
+
+/*
+ * Run job(0) to job(count - 1) across the pool and wait for all of them
+ * to finish
+ */
+void runWorkers(void (*job)(int), int count);
@@ -0,0 +1,621 @@
+/* World cube storage and the face exposure mask kept alongside it */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "graphics.h"
+#include "world.h"
+#include "occlusion.h"
+
+
+int worldSizeX = WORLDDEFAULTX, worldSizeY = WORLDDEFAULTY, worldSizeZ = WORLDDEFAULTZ;
+
+#ifdef WORLDLINEAR
+GLubyte *world = NULL;
+#else
+struct worldTile *worldTiles = NULL;
+// The cubes of every uniform tile of each id, filled in the first time
+// an id is used
+static GLubyte uniformCubes[256][TILECUBES];
+static GLubyte uniformFilled[256];
+#endif
+
+GLubyte *faceMask = NULL;
+struct worldColumn *worldColumns = NULL;
+
+// Number of cubes with an exposed face in each octree node, level 0 nodes
+// are bricks and each level up doubles the node size.  Each level is its
+// own grid of occupancyX/Y/Z nodes.
+int occupancyLevels;
+static int *occupancy[OCCUPANCYLEVELS];
+static int occupancyX[OCCUPANCYLEVELS], occupancyY[OCCUPANCYLEVELS];
+static int occupancyZ[OCCUPANCYLEVELS];
+
+// Generation of the last cube edit over the whole world, and of the last
+// edit which changed each chunk's mesh
+static unsigned int editGeneration = 0;
+static unsigned int *chunkEditGeneration = NULL;
+
+/*
+ * calloc() which aborts when the memory can't be had
+ */
+static void *worldAlloc(size_t count, size_t size, const char *what){
+   void *p = calloc(count, size);
+
+   if(p == NULL){
+      fprintf(stderr, "ERROR: Could not allocate the %s for a %dx%dx%d world! Aborting!\n",
+         what, WORLDX, WORLDY, WORLDZ);
+      exit(1);
+   }
+   return p;
+}
+
+#ifndef WORLDLINEAR
+/*
+ * Make t a uniform tile of id, releasing its own cubes
+ */
+static void setUniform(struct worldTile *t, GLubyte id){
+   if(!t->uniform){
+      free(t->cubes);
+   }
+   if(!uniformFilled[id]){
+      memset(uniformCubes[id], id, TILECUBES);
+      uniformFilled[id] = 1;
+   }
+   t->cubes = uniformCubes[id];
+   t->uniform = 1;
+   t->id = id;
+}
+#endif
+
+void worldSplitTile(int tile){
+#ifndef WORLDLINEAR
+   struct worldTile *t = &worldTiles[tile];
+
+   t->cubes = malloc(TILECUBES);
+   if(t->cubes == NULL){
+      fprintf(stderr, "ERROR: Could not allocate a world tile! Aborting!\n");
+      exit(1);
+   }
+   memset(t->cubes, t->id, TILECUBES);
+   t->uniform = 0;
+#endif
+}
+
+void initWorld(){
+   int level, side;
+
+   if(WORLDX < WORLDMINX || WORLDY < WORLDMINY || WORLDZ < WORLDMINZ
+         || WORLDX > WORLDMAX || WORLDY > WORLDMAX || WORLDZ > WORLDMAX){
+      fprintf(stderr, "ERROR: A %dx%dx%d world is not between %dx%dx%d and %dx%dx%d! Aborting!\n",
+         WORLDX, WORLDY, WORLDZ, WORLDMINX, WORLDMINY, WORLDMINZ,
+         WORLDMAX, WORLDMAX, WORLDMAX);
+      exit(1);
+   }
+
+#ifdef WORLDLINEAR
+   world = worldAlloc(WORLDCELLS, sizeof(GLubyte), "cubes");
+#else
+   worldTiles = worldAlloc(TILECOUNT, sizeof(struct worldTile), "tiles");
+#endif
+   faceMask = worldAlloc(WORLDCELLS, sizeof(GLubyte), "face mask");
+   worldColumns = worldAlloc(WORLDX * WORLDZ, sizeof(struct worldColumn), "columns");
+   chunkEditGeneration = worldAlloc(CHUNKCOUNT, sizeof(unsigned int), "chunk generations");
+
+   // Enough levels for the top node to cover the longest side
+   side = (WORLDX > WORLDY) ? WORLDX : WORLDY;
+   if(WORLDZ > side) side = WORLDZ;
+   occupancyLevels = 1;
+   while((BRICKSIZE << (occupancyLevels - 1)) < side){
+      occupancyLevels++;
+   }
+   for(level = 0; level < occupancyLevels; level++){
+      occupancyX[level] = (BRICKX + (1 << level) - 1) >> level;
+      occupancyY[level] = (BRICKY + (1 << level) - 1) >> level;
+      occupancyZ[level] = (BRICKZ + (1 << level) - 1) >> level;
+      occupancy[level] = worldAlloc(occupancyX[level] * occupancyY[level] * occupancyZ[level],
+         sizeof(int), "octree");
+   }
+
+   initOccluders();
+   worldClear();
+}
+
+void worldClear(){
+   int x, z;
+#ifdef WORLDLINEAR
+   memset(world, 0, WORLDCELLS);
+#else
+   int i;
+
+   // Before the first call every tile is zeroed, a mixed tile with no
+   // cubes, which is freed just the same
+   for(i = 0; i < TILECOUNT; i++){
+      setUniform(&worldTiles[i], 0);
+   }
+#endif
+   for(x = 0; x < WORLDX; x++){
+      for(z = 0; z < WORLDZ; z++){
+         worldColumns[x * WORLDZ + z].bottom = WORLDY;
+         worldColumns[x * WORLDZ + z].top = -1;
+         worldColumns[x * WORLDZ + z].ground = -1;
+      }
+   }
+}
+
+void worldShrinkColumn(int x, int z){
+   struct worldColumn *column = &worldColumns[x * WORLDZ + z];
+   int ground;
+
+   while(column->top >= column->bottom && worldGet(x, column->top, z) == 0){
+      column->top--;
+   }
+   while(column->bottom <= column->top && worldGet(x, column->bottom, z) == 0){
+      column->bottom++;
+   }
+   if(column->top < column->bottom){
+      column->bottom = WORLDY;
+      column->top = -1;
+   }
+   // The ground can't be above the top or in the top layer
+   ground = column->ground;
+   if(ground > column->top) ground = column->top;
+   if(ground > WORLDY - 2) ground = WORLDY - 2;
+   while(ground >= column->bottom && worldGet(x, ground, z) == 0){
+      ground--;
+   }
+   column->ground = (ground < column->bottom) ? -1 : ground;
+}
+
+void worldCompact(){
+#ifndef WORLDLINEAR
+   int i, n;
+
+   for(i = 0; i < TILECOUNT; i++){
+      GLubyte *cubes = worldTiles[i].cubes;
+      if(worldTiles[i].uniform){
+         continue;
+      }
+      for(n = 1; n < TILECUBES; n++){
+         if(cubes[n] != cubes[0]){
+            break;
+         }
+      }
+      if(n == TILECUBES){
+         setUniform(&worldTiles[i], cubes[0]);
+      }
+   }
+#endif
+}
+
+int worldTileState(int x, int y, int z, GLubyte *id){
+#ifndef WORLDLINEAR
+   const struct worldTile *t = &worldTiles[(x * TILEY + y) * TILEZ + z];
+
+   if(t->uniform){
+      *id = t->id;
+      return (t->id == 0) ? TILE_EMPTY : TILE_UNIFORM;
+   }
+#endif
+   return TILE_MIXED;
+}
+
+void worldRun(int x, int y, int z, int length, GLubyte *run){
+#ifdef WORLDLINEAR
+   memcpy(run, &world[worldIndex(x, y, z)], length);
+#else
+   memcpy(run, &worldTiles[tileIndex(x, y, z)].cubes[tileOffset(x, y, z)], length);
+#endif
+}
+
+int worldStoreSize(){
+#ifdef WORLDLINEAR
+   return WORLDCELLS;
+#else
+   int i, size = TILECOUNT * sizeof(struct worldTile);
+
+   for(i = 0; i < TILECOUNT; i++){
+      if(!worldTiles[i].uniform){
+         size += TILECUBES;
+      }
+   }
+   for(i = 0; i < 256; i++){
+      if(uniformFilled[i]){
+         size += TILECUBES;
+      }
+   }
+   return size;
+#endif
+}
+
+/*
+ * Look up a cube, anything outside of the world is treated as empty
+ */
+static GLubyte cubeAt(int x, int y, int z){
+   if(x < 0 || y < 0 || z < 0 || x >= WORLDX || y >= WORLDY || z >= WORLDZ){
+      return 0;
+   }
+   return worldGet(x, y, z);
+}
+
+/*
+ * Work out which faces of the cube at (x,y,z) can be seen
+ */
+static GLubyte exposedFaces(int x, int y, int z){
+   GLubyte mask = 0;
+
+   if(worldGet(x, y, z) == 0){
+      return 0;
+   }
+   if(cubeAt(x + 1, y, z) == 0) mask |= FACE_XPOS;
+   if(cubeAt(x - 1, y, z) == 0) mask |= FACE_XNEG;
+   if(cubeAt(x, y + 1, z) == 0) mask |= FACE_YPOS;
+   if(cubeAt(x, y - 1, z) == 0) mask |= FACE_YNEG;
+   if(cubeAt(x, y, z + 1) == 0) mask |= FACE_ZPOS;
+   if(cubeAt(x, y, z - 1) == 0) mask |= FACE_ZNEG;
+   return mask;
+}
+
+/*
+ * Add delta to the occupancy of every node holding the cube at (x,y,z)
+ */
+static void addOccupancy(int x, int y, int z, int delta){
+   int level;
+
+   x /= BRICKSIZE;
+   y /= BRICKSIZE;
+   z /= BRICKSIZE;
+   for(level = 0; level < occupancyLevels; level++){
+      int *node = occupancy[level];
+      node[((x >> level) * occupancyY[level] + (y >> level)) * occupancyZ[level]
+         + (z >> level)] += delta;
+   }
+}
+
+/*
+ * Store a new face mask for (x,y,z), keeping the occupancy counts in step
+ */
+static void setFaceMask(int x, int y, int z, GLubyte mask){
+   int n = worldIndex(x, y, z);
+
+   if((faceMask[n] != 0) != (mask != 0)){
+      addOccupancy(x, y, z, (mask != 0) ? 1 : -1);
+   }
+   faceMask[n] = mask;
+}
+
+/*
+ * Start a new edit generation and mark the chunks holding the cubes from
+ * (x0,y0,z0) to (x1,y1,z1) with it, the corners are clamped to the world
+ */
+static void markEdited(int x0, int y0, int z0, int x1, int y1, int z1){
+   int x, y, z;
+
+   if(x0 < 0) x0 = 0;
+   if(y0 < 0) y0 = 0;
+   if(z0 < 0) z0 = 0;
+   if(x1 >= WORLDX) x1 = WORLDX - 1;
+   if(y1 >= WORLDY) y1 = WORLDY - 1;
+   if(z1 >= WORLDZ) z1 = WORLDZ - 1;
+   editGeneration++;
+   for(x = x0 / CHUNKSIZE; x <= x1 / CHUNKSIZE; x++){
+      for(y = y0 / CHUNKSIZE; y <= y1 / CHUNKSIZE; y++){
+         for(z = z0 / CHUNKSIZE; z <= z1 / CHUNKSIZE; z++){
+            chunkEditGeneration[CHUNKINDEX(x, y, z)] = editGeneration;
+         }
+      }
+   }
+}
+
+void computeFaceMask(){
+   int x, y, z, tx, ty, tz, i;
+   GLubyte id;
+
+   // Everything may have changed
+   markEdited(0, 0, 0, WORLDX - 1, WORLDY - 1, WORLDZ - 1);
+   for(i = 0; i < occupancyLevels; i++){
+      memset(occupancy[i], 0, sizeof(int) * occupancyX[i] * occupancyY[i] * occupancyZ[i]);
+   }
+   worldCompact();
+   // Go a tile at a time so empty tiles skip the neighbour tests
+   for(tx = 0; tx < TILEX; tx++){
+      for(ty = 0; ty < TILEY; ty++){
+         for(tz = 0; tz < TILEZ; tz++){
+            int empty = worldTileState(tx, ty, tz, &id) == TILE_EMPTY;
+            for(x = tx * TILESIZE; x < (tx + 1) * TILESIZE && x < WORLDX; x++){
+               for(y = ty * TILESIZE; y < (ty + 1) * TILESIZE && y < WORLDY; y++){
+                  for(z = tz * TILESIZE; z < (tz + 1) * TILESIZE && z < WORLDZ; z++){
+                     GLubyte mask = 0;
+                     if(!empty && y >= columnBottom(x, z) && y <= columnTop(x, z)){
+                        mask = exposedFaces(x, y, z);
+                     }
+                     faceMask[worldIndex(x, y, z)] = mask;
+                     if(mask != 0){
+                        addOccupancy(x, y, z, 1);
+                     }
+                  }
+               }
+            }
+         }
+      }
+   }
+   computeOccluders();
+}
+
+void setCube(int x, int y, int z, GLubyte id){
+   if(x < 0 || y < 0 || z < 0 || x >= WORLDX || y >= WORLDY || z >= WORLDZ){
+      return;
+   }
+   if(worldGet(x, y, z) == id){
+      return;
+   }
+   worldSet(x, y, z, id);
+   updateFaceMask(x, y, z);
+}
+
+/*
+ * Returns 1 if every cube from (x0,y0,z0) to (x1,y1,z1) holds id
+ */
+static int regionHolds(int x0, int y0, int z0, int x1, int y1, int z1,
+      GLubyte id){
+   int x, y, z;
+
+   for(x = x0; x <= x1; x++){
+      for(y = y0; y <= y1; y++){
+         for(z = z0; z <= z1; z++){
+            if(worldGet(x, y, z) != id){
+               return 0;
+            }
+         }
+      }
+   }
+   return 1;
+}
+
+void fillRegion(int x0, int y0, int z0, int x1, int y1, int z1, GLubyte id){
+   int x, y, z;
+
+   if(x0 < 0) x0 = 0;
+   if(y0 < 0) y0 = 0;
+   if(z0 < 0) z0 = 0;
+   if(x1 >= WORLDX) x1 = WORLDX - 1;
+   if(y1 >= WORLDY) y1 = WORLDY - 1;
+   if(z1 >= WORLDZ) z1 = WORLDZ - 1;
+   if(x0 > x1 || y0 > y1 || z0 > z1){
+      return;
+   }
+   // Nothing to do if every cube already holds id
+   if(regionHolds(x0, y0, z0, x1, y1, z1, id)){
+      return;
+   }
+
+#ifdef WORLDLINEAR
+   for(x = x0; x <= x1; x++){
+      for(y = y0; y <= y1; y++){
+         for(z = z0; z <= z1; z++){
+            worldSet(x, y, z, id);
+         }
+      }
+   }
+#else
+   {
+      int tx, ty, tz;
+      // Tiles wholly inside the region become uniform, the cubes of the
+      // tiles around the edge are set one at a time
+      for(tx = x0 / TILESIZE; tx <= x1 / TILESIZE; tx++){
+         for(ty = y0 / TILESIZE; ty <= y1 / TILESIZE; ty++){
+            for(tz = z0 / TILESIZE; tz <= z1 / TILESIZE; tz++){
+               int bx = tx * TILESIZE, by = ty * TILESIZE, bz = tz * TILESIZE;
+               if(bx >= x0 && bx + TILEMASK <= x1 && by >= y0 && by + TILEMASK <= y1
+                     && bz >= z0 && bz + TILEMASK <= z1){
+                  setUniform(&worldTiles[(tx * TILEY + ty) * TILEZ + tz], id);
+                  continue;
+               }
+               for(x = (bx > x0) ? bx : x0; x <= bx + TILEMASK && x <= x1; x++){
+                  for(y = (by > y0) ? by : y0; y <= by + TILEMASK && y <= y1; y++){
+                     for(z = (bz > z0) ? bz : z0; z <= bz + TILEMASK && z <= z1; z++){
+                        worldSet(x, y, z, id);
+                     }
+                  }
+               }
+            }
+         }
+      }
+   }
+#endif
+
+   // Uniform tiles were filled without worldSet() so bring the columns up
+   // to date here
+   for(x = x0; x <= x1; x++){
+      for(z = z0; z <= z1; z++){
+         struct worldColumn *column = &worldColumns[x * WORLDZ + z];
+         if(id != 0){
+            int ground = (y1 < WORLDY - 1) ? y1 : WORLDY - 2;
+            if(y1 > column->top) column->top = y1;
+            if(y0 < column->bottom) column->bottom = y0;
+            if(ground >= y0 && ground > column->ground) column->ground = ground;
+         } else {
+            worldShrinkColumn(x, z);
+         }
+      }
+   }
+
+   // The faces of the region and of the cubes around it may change
+   for(x = (x0 > 0) ? x0 - 1 : 0; x <= x1 + 1 && x < WORLDX; x++){
+      for(y = (y0 > 0) ? y0 - 1 : 0; y <= y1 + 1 && y < WORLDY; y++){
+         for(z = (z0 > 0) ? z0 - 1 : 0; z <= z1 + 1 && z < WORLDZ; z++){
+            setFaceMask(x, y, z, exposedFaces(x, y, z));
+         }
+      }
+   }
+   for(x = x0; x <= x1; x++){
+      for(z = z0; z <= z1; z++){
+         updateOccluderColumn(x, z);
+      }
+   }
+   markEdited(x0 - 1, y0 - 1, z0 - 1, x1 + 1, y1 + 1, z1 + 1);
+}
+
+/*
+ * Work out the face masks of the columns from (x0,z0) to (x1,z1) again,
+ * the corners are clamped to the world.  Leaves the occupancy alone.
+ */
+static void refreshColumns(int x0, int z0, int x1, int z1){
+   int x, y, z;
+
+   if(x0 < 0) x0 = 0;
+   if(z0 < 0) z0 = 0;
+   if(x1 >= WORLDX) x1 = WORLDX - 1;
+   if(z1 >= WORLDZ) z1 = WORLDZ - 1;
+   for(x = x0; x <= x1; x++){
+      for(z = z0; z <= z1; z++){
+         for(y = columnBottom(x, z); y <= columnTop(x, z); y++){
+            faceMask[worldIndex(x, y, z)] = exposedFaces(x, y, z);
+         }
+      }
+   }
+}
+
+void worldShift(int dx, int dz, void (*fill)(int x0, int z0, int x1, int z1)){
+   int xFirst, xLast, xStep, zFirst, zLast, zStep;
+   int x, y, z, i, stripX0, stripX1, stripZ0, stripZ1;
+
+   if(dx == 0 && dz == 0){
+      return;
+   }
+   // Walk the columns starting from the side the window moves towards so
+   // every column is read before it is written over
+   xFirst = (dx >= 0) ? 0 : WORLDX - 1;
+   xLast = (dx >= 0) ? WORLDX : -1;
+   xStep = (dx >= 0) ? 1 : -1;
+   zFirst = (dz >= 0) ? 0 : WORLDZ - 1;
+   zLast = (dz >= 0) ? WORLDZ : -1;
+   zStep = (dz >= 0) ? 1 : -1;
+   for(x = xFirst; x != xLast; x += xStep){
+      for(z = zFirst; z != zLast; z += zStep){
+         int sx = x + dx, sz = z + dz;
+         struct worldColumn *to = &worldColumns[x * WORLDZ + z];
+         struct worldColumn from;
+         int bottom, top;
+         // Columns coming in from outside the window start out empty
+         from.bottom = WORLDY;
+         from.top = -1;
+         from.ground = -1;
+         if(sx >= 0 && sx < WORLDX && sz >= 0 && sz < WORLDZ){
+            from = worldColumns[sx * WORLDZ + sz];
+         }
+         // Only the part of the two columns which holds cubes is copied,
+         // the column takes its new span first so worldSet() never has
+         // to shrink it
+         bottom = (from.bottom < to->bottom) ? from.bottom : to->bottom;
+         top = (from.top > to->top) ? from.top : to->top;
+         *to = from;
+         for(y = bottom; y <= top; y++){
+            if(y >= from.bottom && y <= from.top){
+               worldSet(x, y, z, worldGet(sx, y, sz));
+               faceMask[worldIndex(x, y, z)] = faceMask[worldIndex(sx, y, sz)];
+            } else {
+               worldSet(x, y, z, 0);
+               faceMask[worldIndex(x, y, z)] = 0;
+            }
+         }
+      }
+   }
+
+   // The strips which came in from outside, the z strip leaves out the
+   // corner the x strip already has
+   stripX0 = (dx >= 0) ? WORLDX - dx : 0;
+   stripX1 = (dx >= 0) ? WORLDX - 1 : -dx - 1;
+   stripZ0 = (dz >= 0) ? WORLDZ - dz : 0;
+   stripZ1 = (dz >= 0) ? WORLDZ - 1 : -dz - 1;
+   if(dx != 0){
+      fill(stripX0, 0, stripX1, WORLDZ - 1);
+   }
+   if(dz != 0){
+      fill((dx < 0) ? stripX1 + 1 : 0, stripZ0, (dx > 0) ? stripX0 - 1 : WORLDX - 1, stripZ1);
+   }
+   worldCompact();
+
+   // Faces change in the new strips, along their inside edge and along
+   // the far edges of the window which now face outside
+   if(dx != 0){
+      refreshColumns(stripX0 - 1, 0, stripX1 + 1, WORLDZ - 1);
+      refreshColumns((dx > 0) ? 0 : WORLDX - 1, 0, (dx > 0) ? 0 : WORLDX - 1, WORLDZ - 1);
+   }
+   if(dz != 0){
+      refreshColumns(0, stripZ0 - 1, WORLDX - 1, stripZ1 + 1);
+      refreshColumns(0, (dz > 0) ? 0 : WORLDZ - 1, WORLDX - 1, (dz > 0) ? 0 : WORLDZ - 1);
+   }
+
+   // Every cube has moved, count the octree from scratch and let anything
+   // built from the world know
+   for(i = 0; i < occupancyLevels; i++){
+      memset(occupancy[i], 0, sizeof(int) * occupancyX[i] * occupancyY[i] * occupancyZ[i]);
+   }
+   for(x = 0; x < WORLDX; x++){
+      for(z = 0; z < WORLDZ; z++){
+         for(y = columnBottom(x, z); y <= columnTop(x, z); y++){
+            if(faceMask[worldIndex(x, y, z)] != 0){
+               addOccupancy(x, y, z, 1);
+            }
+         }
+      }
+   }
+   computeOccluders();
+   markEdited(0, 0, 0, WORLDX - 1, WORLDY - 1, WORLDZ - 1);
+}
+
+unsigned int worldGeneration(){
+   return editGeneration;
+}
+
+unsigned int chunkGeneration(int x, int y, int z){
+   if(x < 0 || y < 0 || z < 0 || x >= CHUNKX || y >= CHUNKY || z >= CHUNKZ){
+      return 0;
+   }
+   return chunkEditGeneration[CHUNKINDEX(x, y, z)];
+}
+
+int worldDirtyChunks(unsigned int since, int list[][3]){
+   int x, y, z, count = 0;
+
+   for(x = 0; x < CHUNKX; x++){
+      for(y = 0; y < CHUNKY; y++){
+         for(z = 0; z < CHUNKZ; z++){
+            if(chunkEditGeneration[CHUNKINDEX(x, y, z)] > since){
+               list[count][0] = x;
+               list[count][1] = y;
+               list[count][2] = z;
+               count++;
+            }
+         }
+      }
+   }
+   return count;
+}
+
+void updateFaceMask(int x, int y, int z){
+   if(x < 0 || y < 0 || z < 0 || x >= WORLDX || y >= WORLDY || z >= WORLDZ){
+      return;
+   }
+   // The neighbours' faces change too and they may be in the next chunk
+   markEdited(x - 1, y - 1, z - 1, x + 1, y + 1, z + 1);
+   setFaceMask(x, y, z, exposedFaces(x, y, z));
+   // The neighbours only lose or gain the face that touches this cube
+   if(x > 0) setFaceMask(x - 1, y, z, exposedFaces(x - 1, y, z));
+   if(x < WORLDX - 1) setFaceMask(x + 1, y, z, exposedFaces(x + 1, y, z));
+   if(y > 0) setFaceMask(x, y - 1, z, exposedFaces(x, y - 1, z));
+   if(y < WORLDY - 1) setFaceMask(x, y + 1, z, exposedFaces(x, y + 1, z));
+   if(z > 0) setFaceMask(x, y, z - 1, exposedFaces(x, y, z - 1));
+   if(z < WORLDZ - 1) setFaceMask(x, y, z + 1, exposedFaces(x, y, z + 1));
+   updateOccluderColumn(x, z);
+}
+
+int occupiedCount(int level, int x, int y, int z){
+   if(level < 0 || level >= occupancyLevels || x < 0 || y < 0 || z < 0
+         || x >= occupancyX[level] || y >= occupancyY[level] || z >= occupancyZ[level]){
+      return 0;
+   }
+   return occupancy[level][(x * occupancyY[level] + y) * occupancyZ[level] + z];
+}
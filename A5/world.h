@@ -0,0 +1,284 @@
+/*
+ * Storage for the world's cubes and the bookkeeping kept alongside it.
+ * Cubes are read and written with worldGet() and worldSet().
+ * faceMaskGet(x,y,z) holds one FACE_* bit (see graphics.h) for each side of
+ * the cube at (x,y,z) which is not covered by a neighbour.  Empty and
+ * fully buried cubes have a mask of 0.
+ * The occluder columns used by occlusion.c are kept up to date here as well.
+ *
+ * The cubes with a non-zero face mask are also counted in an octree of
+ * nodes which starts at BRICKSIZE^3 bricks (level 0) and doubles in size
+ * each level, so culling can skip empty space without looking at it.
+ */
+
+	/* the world is stored as a grid of TILESIZE^3 tiles of cubes, a tile */
+	/* where every cube has the same id (e.g. air or buried rock) is just */
+	/* the id and the rest hold a dense copy of their cubes */
+	/* faceMask is one dense array in the same tile order so neighbouring */
+	/* cubes share cache lines, z is lowest within a tile so short runs */
+	/* along z are contiguous */
+	/* build with -DWORLDLINEAR to store both as plain [x][y][z] arrays */
+#define TILEBITS 3
+#define TILESIZE (1 << TILEBITS)
+#define TILEMASK (TILESIZE - 1)
+#define TILECUBES (TILESIZE * TILESIZE * TILESIZE)
+#define TILEX ((WORLDX + TILESIZE - 1) / TILESIZE)
+#define TILEY ((WORLDY + TILESIZE - 1) / TILESIZE)
+#define TILEZ ((WORLDZ + TILESIZE - 1) / TILESIZE)
+#define TILECOUNT (TILEX * TILEY * TILEZ)
+#ifdef WORLDLINEAR
+#define WORLDCELLS (WORLDX * WORLDY * WORLDZ)
+#define WORLDLAYOUT "linear"
+#else
+#define WORLDCELLS (TILECOUNT * TILECUBES)
+#define WORLDLAYOUT "tiled"
+#endif
+
+	/* states returned by worldTileState() */
+#define TILE_EMPTY 0
+#define TILE_UNIFORM 1
+#define TILE_MIXED 2
+
+#ifdef WORLDLINEAR
+	/* cube ids, defined in world.c */
+extern GLubyte *world;
+#else
+struct worldTile {
+   // TILECUBES ids in tile order, uniform tiles all share one copy for
+   // each id so reading never has to check
+   GLubyte *cubes;
+   // Set when every cube in the tile is id
+   GLubyte uniform;
+   GLubyte id;
+};
+	/* the tile grid, defined in world.c */
+extern struct worldTile *worldTiles;
+#endif
+	/* exposed sides of each cube, FACE_* bits */
+extern GLubyte *faceMask;
+
+	/* lowest and highest non-empty cube in each (x,z) column of the */
+	/* world, bottom > top when the column is empty.  ground is the */
+	/* highest non-empty cube under the top layer of the world (y = */
+	/* WORLDY - 1, where the outdoor floor keeps its clouds) or -1 */
+struct worldColumn {
+   short bottom, top, ground;
+};
+	/* kept up to date by worldSet(), defined in world.c, column (x,z) */
+	/* is at x * WORLDZ + z */
+extern struct worldColumn *worldColumns;
+
+/*
+ * Tile holding the cube at (x,y,z) and the cube's offset within the tile
+ */
+static inline int tileIndex(int x, int y, int z){
+   return ((x >> TILEBITS) * TILEY + (y >> TILEBITS)) * TILEZ + (z >> TILEBITS);
+}
+
+static inline int tileOffset(int x, int y, int z){
+   return ((x & TILEMASK) << (2 * TILEBITS)) | ((y & TILEMASK) << TILEBITS)
+      | (z & TILEMASK);
+}
+
+/*
+ * Offset of the cube at (x,y,z) in faceMask[], the cube must be inside the
+ * world
+ */
+static inline int worldIndex(int x, int y, int z){
+#ifdef WORLDLINEAR
+   return (x * WORLDY + y) * WORLDZ + z;
+#else
+   return (tileIndex(x, y, z) << (3 * TILEBITS)) | tileOffset(x, y, z);
+#endif
+}
+
+/*
+ * Give a uniform tile its own copy of its cubes so one can be changed,
+ * called by worldSet()
+ */
+void worldSplitTile(int tile);
+
+/*
+ * Move the ends of the (x,z) column and its ground in past any empty
+ * cubes, called by worldSet() when one of them is cleared
+ */
+void worldShrinkColumn(int x, int z);
+
+/*
+ * Read and write the cube id at (x,y,z), which must be inside the world.
+ * Writing keeps the column index up to date but does not update the face
+ * mask, see computeFaceMask() and updateFaceMask().
+ */
+static inline GLubyte worldGet(int x, int y, int z){
+#ifdef WORLDLINEAR
+   return world[worldIndex(x, y, z)];
+#else
+   return worldTiles[tileIndex(x, y, z)].cubes[tileOffset(x, y, z)];
+#endif
+}
+
+static inline void worldSet(int x, int y, int z, GLubyte id){
+   struct worldColumn *column = &worldColumns[x * WORLDZ + z];
+#ifdef WORLDLINEAR
+   world[worldIndex(x, y, z)] = id;
+#else
+   int tile = tileIndex(x, y, z);
+
+   if(worldTiles[tile].uniform){
+      if(worldTiles[tile].id == id){
+         return;
+      }
+      worldSplitTile(tile);
+   }
+   worldTiles[tile].cubes[tileOffset(x, y, z)] = id;
+#endif
+   if(id != 0){
+      if(y > column->top) column->top = y;
+      if(y < column->bottom) column->bottom = y;
+      if(y > column->ground && y < WORLDY - 1) column->ground = y;
+   } else if(y == column->top || y == column->bottom || y == column->ground){
+      worldShrinkColumn(x, z);
+   }
+}
+
+/*
+ * Highest and lowest non-empty cube in the (x,z) column, columnTop() is
+ * -1 and columnBottom() is WORLDY when the column is empty
+ */
+static inline int columnTop(int x, int z){
+   return worldColumns[x * WORLDZ + z].top;
+}
+
+static inline int columnBottom(int x, int z){
+   return worldColumns[x * WORLDZ + z].bottom;
+}
+
+/*
+ * Highest non-empty cube in the (x,z) column below the top layer of the
+ * world, so a cloud overhead is passed over.  -1 when there is none.
+ */
+static inline int columnGround(int x, int z){
+   return worldColumns[x * WORLDZ + z].ground;
+}
+
+/*
+ * Exposed faces of the cube at (x,y,z), which must be inside the world
+ */
+static inline GLubyte faceMaskGet(int x, int y, int z){
+   return faceMask[worldIndex(x, y, z)];
+}
+
+/*
+ * Allocate the storage for a WORLDX x WORLDY x WORLDZ world and empty it,
+ * graphicsInit() calls this once the size is known.  Exits if the size
+ * is outside WORLDMIN to WORLDMAX.
+ */
+void initWorld();
+
+/*
+ * Empty the whole world, releasing every tile's cubes
+ */
+void worldClear();
+
+/*
+ * Turn mixed tiles whose cubes have all become the same back into uniform
+ * tiles.  computeFaceMask() does this before it starts.
+ */
+void worldCompact();
+
+/*
+ * TILE_EMPTY, TILE_UNIFORM or TILE_MIXED for the tile at tile coordinates
+ * (x,y,z), id is set to the id of an empty or uniform tile.  Always
+ * TILE_MIXED with -DWORLDLINEAR.
+ */
+int worldTileState(int x, int y, int z, GLubyte *id);
+
+/*
+ * Copy the length cubes from (x,y,z) along z into run, the run must not
+ * cross a tile boundary
+ */
+void worldRun(int x, int y, int z, int length, GLubyte *run);
+
+/*
+ * Bytes used to hold the cube ids
+ */
+int worldStoreSize();
+
+	/* cubes along each side of a level 0 occupancy node */
+#define BRICKSIZE 4
+	/* most levels any world can need, BRICKSIZE << 8 covers WORLDMAX */
+#define OCCUPANCYLEVELS 9
+	/* levels used for this world, the top level node is */
+	/* BRICKSIZE << (occupancyLevels - 1) cubes across and covers the */
+	/* whole world, set by initWorld() */
+extern int occupancyLevels;
+#define BRICKX ((WORLDX + BRICKSIZE - 1) / BRICKSIZE)
+#define BRICKY ((WORLDY + BRICKSIZE - 1) / BRICKSIZE)
+#define BRICKZ ((WORLDZ + BRICKSIZE - 1) / BRICKSIZE)
+#if (CHUNKSIZE % TILESIZE != 0) || (TILESIZE % BRICKSIZE != 0)
+#error "chunks must be made of whole world tiles and tiles of whole bricks"
+#endif
+
+/*
+ * Rebuild the face mask for the whole world, call after the world has been
+ * filled in with worldSet() (e.g. after building a floor).  Every chunk
+ * is marked as edited.
+ */
+void computeFaceMask();
+
+/*
+ * Change the cube at (x,y,z) while the game is running: the face mask and
+ * occluders are patched and the chunks whose meshes change are marked as
+ * edited.  Cubes outside the world are ignored.
+ */
+void setCube(int x, int y, int z, GLubyte id);
+
+/*
+ * setCube() for every cube from (x0,y0,z0) to (x1,y1,z1) inclusive, whole
+ * tiles inside the region are filled in one step.  Returns straight away
+ * when every cube already holds id.
+ */
+void fillRegion(int x0, int y0, int z0, int x1, int y1, int z1, GLubyte id);
+
+/*
+ * Slide the world by (dx,dz) cubes for streaming a larger map through it:
+ * the cube at (x+dx,y,z+dz) moves to (x,y,z) and cubes moved past the edge
+ * are dropped.  fill(x0,z0,x1,z1) is called to fill in the empty columns
+ * from (x0,z0) to (x1,z1) with worldSet(), once for each strip which
+ * came in.  The face mask, octree and occluders are brought up to date and
+ * every chunk is marked as edited.  dx and dz must be smaller than the
+ * world, move the chunk meshes along with shiftChunks().
+ */
+void worldShift(int dx, int dz, void (*fill)(int x0, int z0, int x1, int z1));
+
+/*
+ * Edit generation, counted up by every setCube() (through
+ * updateFaceMask()), fillRegion(), worldShift() and computeFaceMask().
+ * chunkGeneration() is the generation of the last edit which changed the
+ * mesh of the chunk at chunk coordinates (x,y,z).
+ * Anything built from the world (chunk meshes, caches, copies sent over
+ * the network) can remember the generation it was built at and only
+ * redo the chunks with a later one.
+ */
+unsigned int worldGeneration();
+unsigned int chunkGeneration(int x, int y, int z);
+
+/*
+ * Fill list with the chunk coordinates of the chunks edited after
+ * generation since, returns how many there are (at most CHUNKCOUNT)
+ */
+int worldDirtyChunks(unsigned int since, int list[][3]);
+
+/*
+ * Patch the face mask after a single cube at (x,y,z) has changed.
+ * Only the cube and its six neighbours are touched, and their chunks are
+ * marked with a new edit generation.  setCube() calls this.
+ */
+void updateFaceMask(int x, int y, int z);
+
+/*
+ * Number of cubes with a visible face in occupancy node (x,y,z) of level.
+ * The node covers cubes x * (BRICKSIZE << level) up to the next node.
+ * Nodes outside the world hold 0.
+ */
+int occupiedCount(int level, int x, int y, int z);